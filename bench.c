@@ -0,0 +1,443 @@
+/*
+ * bench.c
+ *
+ * Micro-benchmarks for the board primitives: move generation, win tests,
+ * leaf evaluation (including a network with random weights) and position
+ * hashing, each timed over a set of random
+ * mid-game positions on several board sizes. Every benchmark is run once
+ * to warm the caches, then timed over a number of repetitions; the mean,
+ * standard deviation and minimum are reported in ns per operation.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "board.h"
+#include "bitboard.h"
+#include "linked_list.h"
+#include "tree.h"
+#include "eval.h"
+#include "nnue.h"
+
+/* Random positions per board size */
+#define BENCH_POSITIONS 1024
+/* Passes over the positions per timed repetition */
+#define BENCH_PASSES 64
+/* Timed repetitions, after one warmup */
+#define BENCH_REPS 10
+/* Layer widths of the benchmarked network */
+#define BENCH_HIDDEN1 128
+#define BENCH_HIDDEN2 32
+
+void error(char* msg);
+
+typedef struct bench_set {
+	int num_rows;
+	int num_cols;
+	int r;
+	node nodes[BENCH_POSITIONS];   /* positions, as tree nodes for the heuristics */
+	bitboard bitboards[BENCH_POSITIONS];
+	uint64_t p1[BENCH_POSITIONS];
+	uint64_t mask[BENCH_POSITIONS];
+	int columns[BENCH_POSITIONS];  /* a legal move in each position */
+	evaluator e;
+	nn_network* net;                /* random weights; only the speed matters */
+	nn_accumulator accs[BENCH_POSITIONS];
+	uint64_t cells[BENCH_POSITIONS];  /* the cell each legal move fills */
+} bench_set;
+
+/* Results are folded in here so no benchmark is optimized away */
+static volatile long sink;
+
+/**
+ * Returns the monotonic clock in nanoseconds.
+ */
+static double now_ns()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/**
+ * Gives a set a network with random weights, the accumulators of its
+ * positions and the cells of their moves.
+ */
+static void fill_network(bench_set* set)
+{
+	nn_network* net = nn_create(set->num_rows, set->num_cols, set->r, BENCH_HIDDEN1, BENCH_HIDDEN2, WIN_SCORE);
+	int i;
+	if (net == NULL) { error("bench: could not create network"); }
+	for (i = 0; i < 2 * 64 * BENCH_HIDDEN1; i++)
+		net->weights1[i] = rand() % 65 - 32;
+	for (i = 0; i < BENCH_HIDDEN1; i++)
+		net->bias1[i] = rand() % 128;
+	for (i = 0; i < BENCH_HIDDEN2 * BENCH_HIDDEN1; i++)
+		net->weights2[i] = rand() % 65 - 32;
+	for (i = 0; i < BENCH_HIDDEN2; i++)
+		net->weights3[i] = rand() % 65 - 32;
+	nn_delete(set->net);
+	set->net = net;
+	for (i = 0; i < BENCH_POSITIONS; i++) {
+		uint64_t playable = set->mask[i] + bottom_mask(set->num_rows, set->num_cols);
+		set->cells[i] = playable & column_mask(set->num_rows, set->columns[i]);
+		nn_refresh(net, &set->accs[i], set->p1[i], set->mask[i]);
+	}
+}
+
+/**
+ * Fills a set with random positions reached by random play, stopping short
+ * of any position that is won or full.
+ */
+static void fill_set(bench_set* set, int num_rows, int num_cols, int r)
+{
+	int i;
+	set->num_rows = num_rows;
+	set->num_cols = num_cols;
+	set->r = r;
+	for (i = 0; i < BENCH_POSITIONS; i++) {
+		board* b = &set->nodes[i].value;
+		int moves = rand() % (num_rows * num_cols / 2), player = 1, m;
+		memset(&set->nodes[i], 0, sizeof(node));
+		b->row_len = num_rows;
+		b->column_len = num_cols;
+		b->r = r;
+		b->size = num_rows * num_cols;
+		b->move = 0;
+		for (m = 0; m < moves; m++) {
+			board next = *b;
+			if (add_checker(&next, rand() % num_cols, player) != 0 || terminal_test(&next) != 0)
+				continue;
+			*b = next;
+			swap(&player);
+		}
+		do {
+			set->columns[i] = rand() % num_cols;
+		} while (get_cell(b, set->columns[i]) != 0);
+
+		if (bitboard_fits(num_rows, num_cols)) {
+			bitboard_encode(b, &set->bitboards[i]);
+			set->p1[i] = set->bitboards[i].p1;
+			set->mask[i] = set->bitboards[i].mask;
+		}
+	}
+	if (bitboard_fits(num_rows, num_cols)) {
+		eval_init(&set->e, num_rows, num_cols, r, WIN_SCORE);
+		fill_network(set);
+	}
+}
+
+/*
+ * Benchmarks: each performs its operation once per position and returns
+ * the number of operations done.
+ */
+static long bench_struct_copy(bench_set* set)
+{
+	long sum = 0;
+	int i;
+	for (i = 0; i < BENCH_POSITIONS; i++) {
+		board b = set->nodes[i].value;
+		sum += b.cells[i % BOARD_BYTES];
+	}
+	sink += sum;
+	return BENCH_POSITIONS;
+}
+
+static long bench_add_checker(bench_set* set)
+{
+	long sum = 0;
+	int i;
+	for (i = 0; i < BENCH_POSITIONS; i++) {
+		board b = set->nodes[i].value;
+		sum += add_checker(&b, set->columns[i], 1);
+	}
+	sink += sum;
+	return BENCH_POSITIONS;
+}
+
+static long bench_copy_board(bench_set* set)
+{
+	int i;
+	for (i = 0; i < BENCH_POSITIONS; i++) {
+		board* b = copy_board(&set->nodes[i].value);
+		sink += b->size;
+		delete_board(b);
+	}
+	return BENCH_POSITIONS;
+}
+
+static long bench_terminal_test(bench_set* set)
+{
+	long sum = 0;
+	int i;
+	for (i = 0; i < BENCH_POSITIONS; i++)
+		sum += terminal_test(&set->nodes[i].value);
+	sink += sum;
+	return BENCH_POSITIONS;
+}
+
+static long bench_check_horizontal(bench_set* set)
+{
+	long sum = 0;
+	int i;
+	for (i = 0; i < BENCH_POSITIONS; i++)
+		sum += check_horizontal(&set->nodes[i].value);
+	sink += sum;
+	return BENCH_POSITIONS;
+}
+
+static long bench_check_vertical(bench_set* set)
+{
+	long sum = 0;
+	int i;
+	for (i = 0; i < BENCH_POSITIONS; i++)
+		sum += check_vertical(&set->nodes[i].value);
+	sink += sum;
+	return BENCH_POSITIONS;
+}
+
+static long bench_check_forward_diag(bench_set* set)
+{
+	long sum = 0;
+	int i;
+	for (i = 0; i < BENCH_POSITIONS; i++)
+		sum += check_forward_diag(&set->nodes[i].value);
+	sink += sum;
+	return BENCH_POSITIONS;
+}
+
+static long bench_check_backwards_diag(bench_set* set)
+{
+	long sum = 0;
+	int i;
+	for (i = 0; i < BENCH_POSITIONS; i++)
+		sum += check_backwards_diag(&set->nodes[i].value);
+	sink += sum;
+	return BENCH_POSITIONS;
+}
+
+static long bench_get_best_max(bench_set* set)
+{
+	long sum = 0;
+	int i;
+	for (i = 0; i < BENCH_POSITIONS; i++) {
+		node* n = &set->nodes[i];
+		n->value.best_score = 0;
+		get_best_max(&n);
+		sum += n->value.best_score;
+	}
+	sink += sum;
+	return BENCH_POSITIONS;
+}
+
+static long bench_get_best_min(bench_set* set)
+{
+	long sum = 0;
+	int i;
+	for (i = 0; i < BENCH_POSITIONS; i++) {
+		node* n = &set->nodes[i];
+		n->value.best_score = 0;
+		get_best_min(&n);
+		sum += n->value.best_score;
+	}
+	sink += sum;
+	return BENCH_POSITIONS;
+}
+
+static long bench_eval_position(bench_set* set)
+{
+	long sum = 0;
+	int i;
+	for (i = 0; i < BENCH_POSITIONS; i++)
+		sum += eval_position(&set->e, &set->bitboards[i]);
+	sink += sum;
+	return BENCH_POSITIONS;
+}
+
+static long bench_eval_positions(bench_set* set)
+{
+	int scores[BENCH_POSITIONS];
+	eval_positions(&set->e, set->p1, set->mask, scores, BENCH_POSITIONS);
+	sink += scores[0] + scores[BENCH_POSITIONS - 1];
+	return BENCH_POSITIONS;
+}
+
+static long bench_eval_positions_scalar(bench_set* set)
+{
+	int avx2 = set->e.avx2;
+	set->e.avx2 = 0;
+	bench_eval_positions(set);
+	set->e.avx2 = avx2;
+	return BENCH_POSITIONS;
+}
+
+static long bench_nn_position(bench_set* set)
+{
+	long sum = 0;
+	int i;
+	for (i = 0; i < BENCH_POSITIONS; i++)
+		sum += nn_position(set->net, &set->bitboards[i]);
+	sink += sum;
+	return BENCH_POSITIONS;
+}
+
+static long bench_nn_incremental(bench_set* set)
+{
+	long sum = 0;
+	int i;
+	for (i = 0; i < BENCH_POSITIONS; i++) {
+		nn_add(set->net, &set->accs[i], set->cells[i], 1);
+		sum += nn_evaluate(set->net, &set->accs[i]);
+		nn_remove(set->net, &set->accs[i], set->cells[i], 1);
+	}
+	sink += sum;
+	return BENCH_POSITIONS;
+}
+
+static long bench_nn_incremental_scalar(bench_set* set)
+{
+	int avx2 = set->net->avx2;
+	set->net->avx2 = 0;
+	bench_nn_incremental(set);
+	set->net->avx2 = avx2;
+	return BENCH_POSITIONS;
+}
+
+static long bench_bitboard_encode(bench_set* set)
+{
+	long sum = 0;
+	int i;
+	for (i = 0; i < BENCH_POSITIONS; i++) {
+		bitboard bb;
+		bitboard_encode(&set->nodes[i].value, &bb);
+		sum += bb.mask;
+	}
+	sink += sum;
+	return BENCH_POSITIONS;
+}
+
+static long bench_board_key(bench_set* set)
+{
+	long sum = 0;
+	int i;
+	for (i = 0; i < BENCH_POSITIONS; i++)
+		sum += board_key(&set->nodes[i].value);
+	sink += sum;
+	return BENCH_POSITIONS;
+}
+
+static long bench_board_canonical_key(bench_set* set)
+{
+	long sum = 0;
+	int i;
+	for (i = 0; i < BENCH_POSITIONS; i++)
+		sum += board_canonical_key(&set->nodes[i].value, NULL);
+	sink += sum;
+	return BENCH_POSITIONS;
+}
+
+static long bench_bitboard_canonical_key(bench_set* set)
+{
+	long sum = 0;
+	int i;
+	for (i = 0; i < BENCH_POSITIONS; i++)
+		sum += bitboard_canonical_key(&set->bitboards[i], NULL);
+	sink += sum;
+	return BENCH_POSITIONS;
+}
+
+typedef struct benchmark {
+	const char* name;
+	long (*run)(bench_set* set);
+	int needs_bitboard;
+} benchmark;
+
+static benchmark benchmarks[] = {
+	{ "board struct copy", bench_struct_copy, 0 },
+	{ "add_checker", bench_add_checker, 0 },
+	{ "copy_board", bench_copy_board, 0 },
+	{ "terminal_test", bench_terminal_test, 0 },
+	{ "check_horizontal", bench_check_horizontal, 0 },
+	{ "check_vertical", bench_check_vertical, 0 },
+	{ "check_forward_diag", bench_check_forward_diag, 0 },
+	{ "check_backwards_diag", bench_check_backwards_diag, 0 },
+	{ "get_best_max", bench_get_best_max, 0 },
+	{ "get_best_min", bench_get_best_min, 0 },
+	{ "eval_position", bench_eval_position, 1 },
+	{ "eval_positions", bench_eval_positions, 1 },
+	{ "eval_positions (scalar)", bench_eval_positions_scalar, 1 },
+	{ "nn_position", bench_nn_position, 1 },
+	{ "nn_evaluate (incremental)", bench_nn_incremental, 1 },
+	{ "nn_evaluate (scalar)", bench_nn_incremental_scalar, 1 },
+	{ "bitboard_encode", bench_bitboard_encode, 1 },
+	{ "board_key", bench_board_key, 0 },
+	{ "board_canonical_key", bench_board_canonical_key, 0 },
+	{ "bitboard_canonical_key", bench_bitboard_canonical_key, 1 },
+};
+
+/**
+ * Runs one benchmark: a warmup, then reps timed repetitions of
+ * BENCH_PASSES passes over the positions.
+ */
+static void run_benchmark(benchmark* bm, bench_set* set, int reps)
+{
+	double times[reps];
+	double mean = 0, variance = 0, best = 0;
+	int rep, pass;
+
+	bm->run(set);
+	for (rep = 0; rep < reps; rep++) {
+		long ops = 0;
+		double start = now_ns();
+		for (pass = 0; pass < BENCH_PASSES; pass++)
+			ops += bm->run(set);
+		times[rep] = (now_ns() - start) / ops;
+		mean += times[rep];
+		if (rep == 0 || times[rep] < best)
+			best = times[rep];
+	}
+	mean /= reps;
+	for (rep = 0; rep < reps; rep++)
+		variance += (times[rep] - mean) * (times[rep] - mean);
+	variance = (reps > 1) ? variance / (reps - 1) : 0;
+
+	printf("  %-26s %10.2f %10.2f %10.2f\n", bm->name, mean, sqrt(variance), best);
+}
+
+int main(int argc, char* argv[])
+{
+	int sizes[][3] = { { 4, 5, 4 }, { 6, 7, 4 }, { 7, 8, 5 }, { 10, 12, 5 } };
+	int reps = BENCH_REPS;
+	int s, i;
+
+	if (argc > 2) { error("usage -- ./bench [repetitions]"); }
+	if (argc == 2)
+		reps = strtol(argv[1], NULL, 10);
+	if (reps < 1) { error("bench: repetitions must be positive"); }
+
+	srand(1);
+	bench_set* set = calloc(1, sizeof(bench_set));
+	for (s = 0; s < (int) (sizeof(sizes) / sizeof(sizes[0])); s++) {
+		if (sizes[s][0] * sizes[s][1] > BOARD_MAX_CELLS)
+			continue;
+		fill_set(set, sizes[s][0], sizes[s][1], sizes[s][2]);
+		printf("%dx%d r=%d, %d positions, %d repetitions (ns/op)\n", sizes[s][0], sizes[s][1],
+				sizes[s][2], BENCH_POSITIONS, reps);
+		printf("  %-26s %10s %10s %10s\n", "", "mean", "stddev", "min");
+		for (i = 0; i < (int) (sizeof(benchmarks) / sizeof(benchmarks[0])); i++) {
+			if (benchmarks[i].needs_bitboard && !bitboard_fits(sizes[s][0], sizes[s][1]))
+				continue;
+			run_benchmark(&benchmarks[i], set, reps);
+		}
+	}
+	nn_delete(set->net);
+	free(set);
+	return 0;
+}
+
+void error(char* msg)
+{
+	printf("%s\n", msg);
+	exit(1);
+}
@@ -0,0 +1,274 @@
+#include <stdint.h>
+#include <string.h>
+#include "board.h"
+#include "bitboard.h"
+
+/**
+ * Returns non-zero when a board with the given dimensions fits in a
+ * 64-bit column-major bitboard (one spare bit per column).
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ */
+int bitboard_fits(int num_rows, int num_cols)
+{
+	return (num_rows + 1) * num_cols <= 64;
+}
+
+/**
+ * Returns a mask with the bottom cell of every column set.
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ */
+uint64_t bottom_mask(int num_rows, int num_cols)
+{
+	uint64_t mask = 0;
+	int i;
+	for (i = 0; i < num_cols; i++) {
+		mask |= (uint64_t) 1 << (i * (num_rows + 1));
+	}
+	return mask;
+}
+
+/**
+ * Returns a mask with every playable cell of the column set.
+ * @param num_rows: number of rows on the board
+ * @param col: the column
+ */
+uint64_t column_mask(int num_rows, int col)
+{
+	return (((uint64_t) 1 << num_rows) - 1) << (col * (num_rows + 1));
+}
+
+/**
+ * Encodes the checkers of a board into a bitboard. The board must fit.
+ * @param b: the board to encode
+ * @param bb: the bitboard to fill
+ */
+void bitboard_encode(board* b, bitboard* bb)
+{
+	int h = b->row_len + 1;
+	int row, col, moves = 0;
+
+	bb->p1 = 0;
+	bb->mask = 0;
+	for (row = 0; row < b->row_len; row++) {
+		// Row 0 is the top of the board, height 0 the bottom
+		int height = b->row_len - 1 - row;
+		for (col = 0; col < b->column_len; col++) {
+			int current = get_cell(b, get_index(b->column_len, row, col));
+			if (current != 0) {
+				uint64_t bit = (uint64_t) 1 << (col * h + height);
+				bb->mask |= bit;
+				if (current == 1)
+					bb->p1 |= bit;
+				moves++;
+			}
+		}
+	}
+	bb->row_len = b->row_len;
+	bb->column_len = b->column_len;
+	bb->r = b->r;
+	bb->moves = moves;
+}
+
+/**
+ * Decodes a bitboard back into the board's cells. The board's dimensions
+ * are taken from the bitboard; its best_score and move are left unchanged.
+ * @param bb: the bitboard to decode
+ * @param b: the board to fill
+ */
+void bitboard_decode(bitboard* bb, board* b)
+{
+	int h = bb->row_len + 1;
+	int row, col;
+
+	b->row_len = bb->row_len;
+	b->column_len = bb->column_len;
+	b->r = bb->r;
+	b->size = bb->row_len * bb->column_len;
+	memset(b->cells, 0, sizeof(b->cells));
+	for (row = 0; row < b->row_len; row++) {
+		int height = b->row_len - 1 - row;
+		for (col = 0; col < b->column_len; col++) {
+			uint64_t bit = (uint64_t) 1 << (col * h + height);
+			if (bb->mask & bit) {
+				set_cell(b, get_index(b->column_len, row, col), (bb->p1 & bit) ? 1 : 2);
+			}
+		}
+	}
+}
+
+/**
+ * Returns the position's key. Adding the bottom mask to the occupied mask
+ * leaves a single marker bit just above each column's top checker, so the
+ * sum is unique for every position that fits.
+ * @param bb: the bitboard
+ */
+uint64_t bitboard_key(bitboard* bb)
+{
+	return bb->p1 + bb->mask + bottom_mask(bb->row_len, bb->column_len);
+}
+
+/**
+ * Rebuilds a bitboard from a key produced by bitboard_key().
+ * @param key: the position key
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ * @param r: number of checkers in a row needed to win
+ * @param bb: the bitboard to fill
+ */
+void bitboard_from_key(uint64_t key, int num_rows, int num_cols, int r, bitboard* bb)
+{
+	int h = num_rows + 1;
+	int col, moves = 0;
+
+	bb->p1 = 0;
+	bb->mask = 0;
+	for (col = 0; col < num_cols; col++) {
+		uint64_t bits = (key >> (col * h)) & (((uint64_t) 1 << h) - 1);
+		// Highest set bit is the marker above the column's checkers
+		int height = 63 - __builtin_clzll(bits);
+		uint64_t below = ((uint64_t) 1 << height) - 1;
+		bb->mask |= below << (col * h);
+		bb->p1 |= (bits & below) << (col * h);
+		moves += height;
+	}
+	bb->row_len = num_rows;
+	bb->column_len = num_cols;
+	bb->r = r;
+	bb->moves = moves;
+}
+
+/**
+ * Returns a 64-bit key for the board. The key is unique for boards that fit
+ * in a bitboard; larger boards get an FNV-1a hash of their packed cells.
+ * @param b: the board
+ */
+uint64_t board_key(board* b)
+{
+	if (bitboard_fits(b->row_len, b->column_len)) {
+		bitboard bb;
+		bitboard_encode(b, &bb);
+		return bitboard_key(&bb);
+	}
+
+	uint64_t hash = 14695981039346656037ULL;
+	int i, bytes = board_bytes(b);
+	for (i = 0; i < bytes; i++) {
+		hash ^= b->cells[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+ * Reverses the column order of a bitboard word.
+ * @param x: the word to reflect
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ */
+static uint64_t mirror_bits(uint64_t x, int num_rows, int num_cols)
+{
+	int h = num_rows + 1;
+
+	// Byte-sized columns reverse with a single byte swap
+	if (h == 8) {
+		return __builtin_bswap64(x) >> (8 * (8 - num_cols));
+	}
+
+	uint64_t column = ((uint64_t) 1 << h) - 1;
+	uint64_t result = 0;
+	int i;
+	for (i = 0; i < num_cols; i++) {
+		result |= ((x >> (i * h)) & column) << ((num_cols - 1 - i) * h);
+	}
+	return result;
+}
+
+/**
+ * Writes the left-right reflection of a bitboard into mirrored.
+ * @param bb: the bitboard to reflect
+ * @param mirrored: the bitboard to fill
+ */
+void bitboard_mirror(bitboard* bb, bitboard* mirrored)
+{
+	*mirrored = *bb;
+	mirrored->p1 = mirror_bits(bb->p1, bb->row_len, bb->column_len);
+	mirrored->mask = mirror_bits(bb->mask, bb->row_len, bb->column_len);
+}
+
+/**
+ * Returns the smaller of the keys of a position and its reflection, so a
+ * position and its mirror share one entry in keyed tables.
+ * @param bb: the bitboard
+ * @param mirrored: set to 1 when the key is the reflection's, may be NULL
+ */
+uint64_t bitboard_canonical_key(bitboard* bb, int* mirrored)
+{
+	uint64_t key = bitboard_key(bb);
+	// The key is a sum of per-column fields, so it reflects like the masks
+	uint64_t reflected = mirror_bits(key, bb->row_len, bb->column_len);
+
+	if (mirrored != NULL)
+		*mirrored = (reflected < key);
+	return (reflected < key) ? reflected : key;
+}
+
+/**
+ * Returns the canonical key of the board. Boards that do not fit in a
+ * bitboard hash the smaller of their packed cells and its reflection.
+ * @param b: the board
+ * @param mirrored: set to 1 when the key is the reflection's, may be NULL
+ */
+uint64_t board_canonical_key(board* b, int* mirrored)
+{
+	if (bitboard_fits(b->row_len, b->column_len)) {
+		bitboard bb;
+		bitboard_encode(b, &bb);
+		return bitboard_canonical_key(&bb, mirrored);
+	}
+
+	board reflected = *b;
+	int row, col;
+	for (row = 0; row < b->row_len; row++) {
+		for (col = 0; col < b->column_len; col++) {
+			int from = get_index(b->column_len, row, col);
+			int to = get_index(b->column_len, row, mirror_column(b->column_len, col));
+			set_cell(&reflected, to, get_cell(b, from));
+		}
+	}
+
+	int flip = memcmp(reflected.cells, b->cells, board_bytes(b)) < 0;
+	if (mirrored != NULL)
+		*mirrored = flip;
+	return board_key(flip ? &reflected : b);
+}
+
+/**
+ * Returns non-zero when the board is its own left-right reflection, in
+ * which case moves in mirrored columns lead to equivalent positions.
+ * @param b: the board
+ */
+int board_is_symmetric(board* b)
+{
+	int row, col;
+	for (row = 0; row < b->row_len; row++) {
+		for (col = 0; col < b->column_len / 2; col++) {
+			int left = get_index(b->column_len, row, col);
+			int right = get_index(b->column_len, row, mirror_column(b->column_len, col));
+			if (get_cell(b, left) != get_cell(b, right))
+				return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * Returns the column that col maps to under left-right reflection.
+ * @param num_cols: number of columns on the board
+ * @param col: the column
+ */
+int mirror_column(int num_cols, int col)
+{
+	return num_cols - 1 - col;
+}
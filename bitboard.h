@@ -0,0 +1,62 @@
+/*
+ * bitboard.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+#ifndef BITBOARD_H_
+#define BITBOARD_H_
+#include <stdint.h>
+#include "board.h"
+
+/*
+ * Column-major bitboard. Bit (col * (row_len + 1) + height) is set when the
+ * cell `height` rows above the bottom of column `col` is occupied; the extra
+ * bit at the top of every column stays clear so shifts never carry from one
+ * column into the next. Boards with (row_len + 1) * column_len <= 64 fit.
+ */
+typedef struct bitboard {
+	uint64_t p1;    /* player 1 checkers */
+	uint64_t mask;  /* occupied cells */
+	unsigned char row_len;
+	unsigned char column_len;
+	unsigned char r;
+	unsigned char moves;
+} bitboard;
+
+/*
+ * Encoding functions
+ */
+/* Non-zero when an n x m board fits in a bitboard */
+int bitboard_fits(int num_rows, int num_cols);
+/* Board <-> bitboard */
+void bitboard_encode(board* b, bitboard* bb);
+void bitboard_decode(bitboard* bb, board* b);
+/* Unique 64-bit key: p1 + mask + bottom */
+uint64_t bitboard_key(bitboard* bb);
+/* Rebuild a bitboard from its key */
+void bitboard_from_key(uint64_t key, int num_rows, int num_cols, int r, bitboard* bb);
+/* Key of a board; unique when it fits, otherwise a hash of its cells */
+uint64_t board_key(board* b);
+
+/*
+ * Symmetry functions
+ */
+/* Left-right reflection of a bitboard */
+void bitboard_mirror(bitboard* bb, bitboard* mirrored);
+/* Smaller of the keys of a position and its mirror; sets *mirrored when
+ * the key belongs to the reflection (may be NULL) */
+uint64_t bitboard_canonical_key(bitboard* bb, int* mirrored);
+/* Canonical key of a board, see board_key() for boards that do not fit */
+uint64_t board_canonical_key(board* b, int* mirrored);
+/* Non-zero when the board equals its own reflection */
+int board_is_symmetric(board* b);
+/* Column a move maps to under reflection */
+int mirror_column(int num_cols, int col);
+
+/*
+ * Mask helpers
+ */
+uint64_t bottom_mask(int num_rows, int num_cols);
+uint64_t column_mask(int num_rows, int col);
+
+#endif /* BITBOARD_H_ */
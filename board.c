@@ -1,4 +1,5 @@
 #include "board.h"
+#include "bitboard.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
@@ -19,37 +20,21 @@ board* init_board(int num_rows, int num_cols, int r)
 	b -> size = num_rows * num_cols;
 	b -> best_score = 0;
 	b -> move = -1;
-
-	int size = b->size;
-	b->array = malloc(sizeof(b->array) * size);
-	memset(b->array, 0, sizeof(b->array) * size);
+	memset(b->cells, 0, sizeof(b->cells));
 	return b;
 }
 
 board* copy_board(board* original)
 {
 	board* new_board = malloc(sizeof(board));
-	new_board -> row_len = original -> row_len;
-	new_board -> column_len = original -> column_len;
-	int size = original -> size;
-	new_board -> size = size;
+	*new_board = *original;
 	new_board -> best_score = 0;
 	new_board -> move = -1;
-
-	new_board -> r = original -> r;
-	new_board -> array = malloc(sizeof(original->array) * size);
-	memset(new_board->array, 0, sizeof(new_board->array) * size);
-
-	int i;
-	for (i = 0; i <= size; i++) {
-		new_board->array[i] = original->array[i];
-	}
 	return new_board;
 }
 
 void delete_board(board* b)
 {
-	free(b->array);
 	free(b);
 }
 
@@ -61,8 +46,8 @@ int add_checker(board* b, int column, int player)
 	// Start at end of array
 	// If column is empty, add checker
 	for (i = end; i >= start; i -= b->column_len) {
-		if (b->array[i] == 0) {
-			b->array[i] = player;
+		if (get_cell(b, i) == 0) {
+			set_cell(b, i, player);
 			b->move = column;
 			return 0;
 		}
@@ -81,7 +66,7 @@ int check_horizontal(board* b)
 		int p1 = 0;
 		int p2 = 0;
 		for (j = 0; j < row_size; j++) {
-			int current = b->array[(i*row_size) + j];
+			int current = get_cell(b, (i*row_size) + j);
 			int result = check_owner(current, &p1, &p2, b->r);
 			if (result > 0)
 				return result;
@@ -101,7 +86,7 @@ int check_vertical(board* b)
 		int p1 = 0;
 		int p2 = 0;
 		for (j = 0; j < col_size; j++) {
-			int current = b->array[i + (j * row_size)];
+			int current = get_cell(b, i + (j * row_size));
 			int result = check_owner(current, &p1, &p2, b->r);
 			if (result > 0)
 				return result;
@@ -124,7 +109,7 @@ int check_forward_diag(board* b)
 		int p1 = 0;
 		int p2 = 0;
 		while (j < b->size) {
-			int current = b->array[j];
+			int current = get_cell(b, j);
 			int result = check_owner(current, &p1, &p2, b->r);
 			if (result > 0)
 				return result;
@@ -144,7 +129,7 @@ int check_forward_diag(board* b)
 		int p2 = 0;
 		for (j = first_column; j <= last_column; j++) {
 			index = get_index(b->column_len, temp, j);
-			int current = b->array[index];
+			int current = get_cell(b, index);
 			int result = check_owner(current, &p1, &p2, b->r);
 			if (result > 0)
 				return result;
@@ -169,7 +154,7 @@ int check_backwards_diag(board* b)
 		int p1 = 0;
 		int p2 = 0;
 		while (j > 0) {
-			int current = b->array[j];
+			int current = get_cell(b, j);
 			int result = check_owner(current, &p1, &p2, b->r);
 			if (result > 0)
 				return result;
@@ -190,7 +175,7 @@ int check_backwards_diag(board* b)
 		int p2 = 0;
 		for (j = first_column; j <= last_column; j++) {
 			index = get_index(b->column_len, temp, j);
-			int current = b->array[index];
+			int current = get_cell(b, index);
 			int result = check_owner(current, &p1, &p2, b->r);
 			if (result > 0)
 				return result;
@@ -216,13 +201,12 @@ int terminal_test(board *b)
 		return win;
 	}
 
-	board* temp = copy_board(b);
+	// Board is full when every column's top cell is taken
 	int i, counter = 0;
-	for (i = 0; i < temp -> column_len; i++) {
-		counter += add_checker(temp, i, 1);
+	for (i = 0; i < b -> column_len; i++) {
+		counter += (get_cell(b, i) != 0);
 	}
-	if (counter == temp -> column_len) {
-		delete_board(temp);
+	if (counter == b -> column_len) {
 		return -1;
 	}
 	return win;
@@ -285,12 +269,12 @@ void print_board(board* b)
 		if (i % mod == 0) {
 			printf("%d| ", j++);
 		}
-		if (b->array[i] == 1) {
-			printf(KRED "%d " RESET, b->array[i]);
-		} else if (b->array[i] == 2) {
-			printf(KBLU "%d " RESET, b->array[i]);
+		if (get_cell(b, i) == 1) {
+			printf(KRED "%d " RESET, get_cell(b, i));
+		} else if (get_cell(b, i) == 2) {
+			printf(KBLU "%d " RESET, get_cell(b, i));
 		} else {
-			printf("%d ", b->array[i]);
+			printf("%d ", get_cell(b, i));
 		}
 
 		if ((i+1) % mod == 0)
@@ -306,13 +290,18 @@ void print_board(board* b)
 
 int compare_board(board* one, board* two)
 {
-	int* arr_one = one -> array;
-	int* arr_two = two -> array;
-
-	if (memcmp(arr_one, arr_two, sizeof(arr_one) * one->size) == 0) {
+	if (bitboard_fits(one->row_len, one->column_len)) {
+		return (board_key(one) == board_key(two)) ? 0 : 1;
+	}
+	if (memcmp(one->cells, two->cells, board_bytes(one)) == 0) {
 		return 0;
 	} else {
 		return 1;
 	}
 }
 
+int board_bytes(board* b)
+{
+	return (b->size + 3) / 4;
+}
+
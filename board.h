@@ -7,14 +7,24 @@
 #ifndef BOARD_H_
 #define BOARD_H_
 
+/*
+ * Cells are stored 2 bits apiece (0 empty, 1 player one, 2 player two),
+ * four to a byte, inline in the board. Override with -DBOARD_MAX_CELLS=n
+ * for boards with more than 128 cells.
+ */
+#ifndef BOARD_MAX_CELLS
+#define BOARD_MAX_CELLS 128
+#endif
+#define BOARD_BYTES ((BOARD_MAX_CELLS + 3) / 4)
+
 typedef struct board {
-	int *array;
-	int row_len;
-	int column_len;
-	int r;
-	int size;
-	int best_score;
-	int move;
+	unsigned char cells[BOARD_BYTES];
+	unsigned char row_len;
+	unsigned char column_len;
+	unsigned char r;
+	signed char move;
+	short size;
+	short best_score;
 } board;
 
 /*
@@ -46,7 +56,22 @@ void swap(int* player);
 void print_board(board* b);
 /* Add checker to specified column */
 int add_checker(board* b, int column, int player);
-/* Compare two board arrays */
+/* Compare two boards, 0 when they hold the same position */
 int compare_board(board* one, board* two);
+/* Number of bytes of cells[] in use */
+int board_bytes(board* b);
+
+/* Read the checker at index i */
+static inline int get_cell(const board* b, int i)
+{
+	return (b->cells[i >> 2] >> ((i & 3) << 1)) & 3;
+}
+
+/* Place player's checker (or 0 to clear) at index i */
+static inline void set_cell(board* b, int i, int player)
+{
+	int shift = (i & 3) << 1;
+	b->cells[i >> 2] = (b->cells[i >> 2] & ~(3 << shift)) | (player << shift);
+}
 
 #endif /* BOARD_H_ */
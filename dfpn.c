@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bitboard.h"
+#include "threat.h"
+#include "memory.h"
+#include "dfpn.h"
+
+void error(char* msg);
+
+/**
+ * Creates a proof-number solver for an n x m connect-r board that fits in
+ * a bitboard.
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ * @param r: number of checkers in a row needed to win
+ * @param table_bits: log2 of the number of table entries, at least 1
+ * @return the solver
+ */
+dfpn* create_dfpn(int num_rows, int num_cols, int r, int table_bits)
+{
+	dfpn* d = (dfpn*) calloc(1, sizeof(dfpn));
+	int i;
+	if (d == NULL) { error("Could not allocate memory for proof-number solver"); }
+	d->row_len = num_rows;
+	d->column_len = num_cols;
+	d->r = r;
+	d->table_bits = table_bits;
+	d->table = (dfpn_entry*) mem_alloc(sizeof(dfpn_entry) << table_bits, 1);
+
+	// Centre columns first, as in the alpha-beta solver
+	for (i = 0; i < num_cols; i++) {
+		d->order[i] = num_cols / 2 + ((i % 2 == 0) ? i / 2 : -(i + 1) / 2);
+	}
+	return d;
+}
+
+/**
+ * Deallocates a proof-number solver.
+ * @param d: the solver
+ */
+void delete_dfpn(dfpn* d)
+{
+	if (d == NULL)
+		return;
+	mem_free(d->table, sizeof(dfpn_entry) << d->table_bits);
+	free(d);
+}
+
+/**
+ * Returns the first of the pair of table entries a key may occupy.
+ */
+static dfpn_entry* find_pair(dfpn* d, uint64_t key)
+{
+	return &d->table[((key * 0x9e3779b97f4a7c15ULL) >> (64 - d->table_bits)) & ~1UL];
+}
+
+/**
+ * Reads a position's numbers, (1, 1) when the table does not hold it.
+ */
+static void lookup(dfpn* d, uint64_t key, uint32_t* phi, uint32_t* delta)
+{
+	dfpn_entry* e = find_pair(d, key);
+	int i;
+	for (i = 0; i < 2; i++) {
+		if (e[i].key == key) {
+			*phi = e[i].phi;
+			*delta = e[i].delta;
+			return;
+		}
+	}
+	*phi = 1;
+	*delta = 1;
+}
+
+/**
+ * Writes a position's numbers over its old entry, an empty one, or the
+ * one of the pair with less work below it.
+ */
+static void store(dfpn* d, uint64_t key, uint32_t phi, uint32_t delta, long work)
+{
+	dfpn_entry* e = find_pair(d, key);
+	if (e[0].key != key && (e[1].key == key || e[1].key == 0 || e[1].work < e[0].work))
+		e++;
+	e->key = key;
+	e->phi = phi;
+	e->delta = delta;
+	e->work = (work > UINT32_MAX) ? UINT32_MAX : work;
+}
+
+/**
+ * Prints the root's proof and disproof numbers, for the attacker.
+ */
+static void report(dfpn* d, int attacking, uint32_t phi, uint32_t delta)
+{
+	d->pn = attacking ? phi : delta;
+	d->dn = attacking ? delta : phi;
+	if (d->progress && d->nodes >= d->next_report) {
+		printf("  pn %u dn %u after %ld nodes\n", d->pn, d->dn, d->nodes);
+		fflush(stdout);
+		d->next_report = d->nodes + DFPN_REPORT;
+	}
+}
+
+/**
+ * Multiple iterative deepening: searches below a position until its phi
+ * reaches thphi or its delta thdelta, always descending into the child
+ * closest to settling the position. A position is settled for the mover
+ * when it can win at once, lost when the threat analysis finds it lost,
+ * and a full board is a failure for the attacker and a success for the
+ * defender. Only the moves the threat analysis allows are children.
+ */
+static void mid(dfpn* d, uint64_t p1, uint64_t mask, int moves, uint32_t thphi, uint32_t thdelta, int ply)
+{
+	int rows = d->row_len, cols = d->column_len;
+	int mover = (moves % 2 == 0) ? 1 : 2;
+	int attacking = (mover == d->attacker);
+	long start = d->nodes++;
+	bitboard bb = { p1, mask, rows, cols, d->r, moves };
+	uint64_t key = bitboard_canonical_key(&bb, NULL);
+	threats t;
+	int i, goal = -1;
+
+	threat_analyze(&bb, mover, &t);
+	if (t.playable == 0)
+		goal = !attacking;
+	else if (t.result == THREAT_WIN)
+		goal = 1;
+	else if (t.result == THREAT_LOSS)
+		goal = 0;
+	if (goal >= 0) {
+		store(d, key, goal ? 0 : DFPN_INF, goal ? DFPN_INF : 0, 1);
+		if (ply == 0)
+			report(d, attacking, goal ? 0 : DFPN_INF, goal ? DFPN_INF : 0);
+		return;
+	}
+
+	uint64_t cells[64], keys[64];
+	int n = 0;
+	for (i = 0; i < cols; i++) {
+		if (!(t.columns & (1u << d->order[i])))
+			continue;
+		bitboard child = bb;
+		cells[n] = t.playable & column_mask(rows, d->order[i]);
+		child.mask |= cells[n];
+		if (mover == 1)
+			child.p1 |= cells[n];
+		child.moves++;
+		keys[n++] = bitboard_canonical_key(&child, NULL);
+	}
+
+	uint32_t phi, delta;
+	while (1) {
+		uint32_t best_phi = 0, second = DFPN_INF;
+		int best = -1;
+		phi = DFPN_INF;
+		delta = 0;
+		for (i = 0; i < n; i++) {
+			uint32_t child_phi, child_delta;
+			lookup(d, keys[i], &child_phi, &child_delta);
+			if (best < 0 || child_delta < phi) {
+				second = phi;
+				phi = child_delta;
+				best_phi = child_phi;
+				best = i;
+			} else if (child_delta < second) {
+				second = child_delta;
+			}
+			// A sum of finite numbers never reaches infinity
+			if (child_phi >= DFPN_INF)
+				delta = DFPN_INF;
+			else if (delta < DFPN_INF)
+				delta = (delta + child_phi >= DFPN_INF) ? DFPN_INF - 1 : delta + child_phi;
+		}
+		if (ply == 0)
+			report(d, attacking, phi, delta);
+		if (phi >= thphi || delta >= thdelta)
+			break;
+
+		uint32_t child_thphi = (thdelta >= DFPN_INF) ? DFPN_INF : thdelta - delta + best_phi;
+		uint32_t child_thdelta = (second + 1 < thphi) ? second + 1 : thphi;
+		uint64_t child_p1 = (mover == 1) ? p1 | cells[best] : p1;
+		mid(d, child_p1, mask | cells[best], moves + 1, child_thphi, child_thdelta, ply + 1);
+	}
+	store(d, key, phi, delta, d->nodes - start);
+}
+
+/**
+ * Proves or disproves a win for a player. The table is cleared first, since
+ * its entries only hold for one attacker.
+ * @param d: the solver
+ * @param bb: the position, player 1 having moved first
+ * @param attacker: the player whose win is to be proved, 1 or 2
+ * @return DFPN_PROVEN or DFPN_DISPROVEN; the root's numbers are left in
+ * d->pn and d->dn
+ */
+int dfpn_prove(dfpn* d, bitboard* bb, int attacker)
+{
+	memset(d->table, 0, sizeof(dfpn_entry) << d->table_bits);
+	d->attacker = attacker;
+	d->next_report = d->nodes + DFPN_REPORT;
+	mid(d, bb->p1, bb->mask, bb->moves, DFPN_INF, DFPN_INF, 0);
+	return (d->pn == 0) ? DFPN_PROVEN : DFPN_DISPROVEN;
+}
+
+/**
+ * Returns the size of the table in bytes.
+ * @param d: the solver
+ */
+size_t dfpn_memory(dfpn* d)
+{
+	return sizeof(dfpn_entry) << d->table_bits;
+}
+
+/**
+ * Returns the number of table entries in use.
+ * @param d: the solver
+ */
+long dfpn_used(dfpn* d)
+{
+	long used = 0, i;
+	for (i = 0; i < (1L << d->table_bits); i++) {
+		used += (d->table[i].key != 0);
+	}
+	return used;
+}
@@ -0,0 +1,67 @@
+/*
+ * dfpn.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+#ifndef DFPN_H_
+#define DFPN_H_
+#include <stdint.h>
+#include <stddef.h>
+#include "bitboard.h"
+
+/* Proof and disproof numbers at or above this are infinite */
+#define DFPN_INF 0x3fffffffu
+
+/* log2 of the number of table entries (96 MB) */
+#define DFPN_TABLE_BITS 22
+
+/* Nodes between progress lines, when progress is on */
+#define DFPN_REPORT (1L << 22)
+
+/* Results of a proof */
+#define DFPN_DISPROVEN 0
+#define DFPN_PROVEN 1
+
+/*
+ * A table entry. Numbers are kept for the player to move: phi is the
+ * effort to show the mover reaches its goal, delta the effort to show it
+ * does not. The attacker's goal is a win, the defender's anything else.
+ */
+typedef struct dfpn_entry {
+	uint64_t key;
+	uint32_t phi;
+	uint32_t delta;
+	uint32_t work;          /* nodes spent below the entry, for replacement */
+	uint32_t reserved;
+} dfpn_entry;
+
+/*
+ * Depth-first proof-number search over bitboards. The table has a fixed
+ * size and is 2-way set associative: a new entry replaces the one of its
+ * pair with less work below it, so memory stays bounded however long the
+ * proof runs. Positions that fit in a bitboard only; player 1 moves first.
+ */
+typedef struct dfpn {
+	int row_len;
+	int column_len;
+	int r;
+	int order[64];          /* columns, centre first */
+	int attacker;           /* 1 or 2, the player whose win is proved */
+	dfpn_entry* table;
+	int table_bits;
+	long nodes;
+	long next_report;
+	int progress;           /* print the root's numbers as the proof runs */
+	uint32_t pn;            /* root's proof and disproof numbers */
+	uint32_t dn;
+} dfpn;
+
+dfpn* create_dfpn(int num_rows, int num_cols, int r, int table_bits);
+void delete_dfpn(dfpn* d);
+/* Prove or disprove a win for attacker (1 or 2) from the position */
+int dfpn_prove(dfpn* d, bitboard* bb, int attacker);
+/* Bytes of table, and the number of entries in use */
+size_t dfpn_memory(dfpn* d);
+long dfpn_used(dfpn* d);
+
+#endif /* DFPN_H_ */
@@ -0,0 +1,856 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/un.h>
+#include "bitboard.h"
+#include "threat.h"
+#include "tablebase.h"
+#include "solve.h"
+#include "distrib.h"
+
+void error(char* msg);
+
+/* Checkpoint file, NULL for none, and seconds between checkpoints */
+static const char* checkpoint_path = NULL;
+static int checkpoint_interval = CHECKPOINT_DEFAULT_INTERVAL;
+static int resume_checkpoint = 0;
+/* Set by SIGINT and SIGTERM once checkpoints are on */
+static volatile sig_atomic_t interrupted = 0;
+
+static int compare_keys(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Returns the index of key in the sorted keys, or -1.
+ */
+static int64_t find_key(uint64_t* keys, uint64_t count, uint64_t key)
+{
+	uint64_t lo = 0, hi = count;
+	while (lo < hi) {
+		uint64_t mid = (lo + hi) / 2;
+		if (keys[mid] < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo < count && keys[lo] == key) ? (int64_t) lo : -1;
+}
+
+/**
+ * Plays the checker at cell for the player to move.
+ */
+static void play_cell(bitboard* bb, uint64_t cell)
+{
+	if (bb->moves % 2 == 0)
+		bb->p1 |= cell;
+	bb->mask |= cell;
+	bb->moves++;
+}
+
+/**
+ * Returns the cells the player to move can play, or 0 when the position
+ * is already decided: the board is full or the mover has a winning move.
+ */
+static uint64_t open_moves(bitboard* bb)
+{
+	uint64_t own = (bb->moves % 2 == 0) ? bb->p1 : bb->p1 ^ bb->mask;
+	uint64_t playable = playable_cells(bb->mask, bb->row_len, bb->column_len);
+	if (winning_cells(own, bb->mask, bb->row_len, bb->column_len, bb->r) & playable)
+		return 0;
+	return playable;
+}
+
+/**
+ * Generates the canonical keys of the children of every undecided
+ * position in a layer, sorted and without duplicates.
+ * @return the number of keys written to *next
+ */
+static uint64_t expand_layer(split* s, uint64_t* keys, uint64_t count, uint64_t** next)
+{
+	uint64_t cap = 1024, len = 0, i;
+	uint64_t* out = malloc(sizeof(uint64_t) * cap);
+
+	for (i = 0; i < count; i++) {
+		bitboard bb;
+		bitboard_from_key(keys[i], s->row_len, s->column_len, s->r, &bb);
+		uint64_t moves = open_moves(&bb);
+		while (moves) {
+			uint64_t cell = moves & -moves;
+			bitboard child = bb;
+			play_cell(&child, cell);
+			if (len == cap) {
+				cap *= 2;
+				out = realloc(out, sizeof(uint64_t) * cap);
+			}
+			out[len++] = bitboard_canonical_key(&child, NULL);
+			moves ^= cell;
+		}
+	}
+
+	qsort(out, len, sizeof(uint64_t), compare_keys);
+	uint64_t kept = 0;
+	for (i = 0; i < len; i++) {
+		if (kept == 0 || out[kept-1] != out[i])
+			out[kept++] = out[i];
+	}
+	*next = out;
+	return kept;
+}
+
+/**
+ * Enumerates the positions of an empty n x m board down to the split ply.
+ * Every position at that ply becomes a work unit with the full window.
+ * @param num_rows: number of rows on the board, (n + 1) * m <= 64
+ * @param num_cols: number of columns on the board
+ * @param r: number of checkers in a row needed to win
+ * @param ply: the split ply, clamped to the number of cells
+ * @return the split
+ */
+split* create_split(int num_rows, int num_cols, int r, int ply)
+{
+	if (!bitboard_fits(num_rows, num_cols)) { error("solve: board must satisfy (n + 1) * m <= 64"); }
+	if (ply > num_rows * num_cols)
+		ply = num_rows * num_cols;
+	if (ply < 0)
+		ply = 0;
+
+	split* s = (split*) malloc(sizeof(split));
+	int num_layers = num_rows * num_cols + 1;
+	int l;
+	s->row_len = num_rows;
+	s->column_len = num_cols;
+	s->r = r;
+	s->ply = ply;
+	s->keys = calloc(num_layers, sizeof(uint64_t*));
+	s->values = calloc(num_layers, sizeof(unsigned char*));
+	s->counts = calloc(num_layers, sizeof(uint64_t));
+
+	bitboard empty;
+	memset(&empty, 0, sizeof(empty));
+	empty.row_len = num_rows;
+	empty.column_len = num_cols;
+	empty.r = r;
+	s->keys[0] = malloc(sizeof(uint64_t));
+	s->keys[0][0] = bitboard_canonical_key(&empty, NULL);
+	s->counts[0] = 1;
+	for (l = 0; l < ply; l++) {
+		s->counts[l+1] = expand_layer(s, s->keys[l], s->counts[l], &s->keys[l+1]);
+	}
+	for (l = 0; l <= ply; l++) {
+		s->values[l] = calloc(s->counts[l] + 1, 1);
+	}
+
+	uint64_t i;
+	s->num_units = s->counts[ply];
+	s->num_done = 0;
+	s->units = calloc(s->num_units + 1, sizeof(work_unit));
+	for (i = 0; i < s->num_units; i++) {
+		s->units[i].key = s->keys[ply][i];
+		s->units[i].alpha = SOLVE_LOSS;
+		s->units[i].beta = SOLVE_WIN;
+		s->units[i].state = UNIT_PENDING;
+	}
+	return s;
+}
+
+/**
+ * Deallocates a split.
+ * @param s: the split
+ */
+void delete_split(split* s)
+{
+	int l;
+	if (s == NULL)
+		return;
+	for (l = 0; l <= s->row_len * s->column_len; l++) {
+		free(s->keys[l]);
+		free(s->values[l]);
+	}
+	free(s->keys);
+	free(s->values);
+	free(s->counts);
+	free(s->units);
+	free(s);
+}
+
+/**
+ * Records the result of a unit. Results for units already done (a unit
+ * re-dispatched after its worker was presumed lost) are ignored.
+ * @param s: the split
+ * @param index: the unit
+ * @param value: its SOLVE_* value
+ * @param nodes: nodes the solve took
+ * @return 1 if the unit was newly finished, 0 otherwise
+ */
+int finish_unit(split* s, uint64_t index, int value, long nodes)
+{
+	work_unit* u = &s->units[index];
+	if (u->state == UNIT_DONE)
+		return 0;
+	u->value = value;
+	u->nodes = nodes;
+	u->state = UNIT_DONE;
+	s->num_done++;
+	return 1;
+}
+
+/**
+ * Assigns values from the solved units up to the empty board. A position
+ * is a win when it has a winning move, a draw when the board is full, and
+ * otherwise the best of its children's values with the sides swapped.
+ * @param s: the split, with every unit done
+ * @return TB_WIN, TB_DRAW or TB_LOSS for the first player
+ */
+int merge_split(split* s)
+{
+	int l;
+	uint64_t i;
+
+	for (i = 0; i < s->num_units; i++) {
+		s->values[s->ply][i] = TB_DRAW + s->units[i].value;
+	}
+
+	for (l = s->ply - 1; l >= 0; l--) {
+		for (i = 0; i < s->counts[l]; i++) {
+			bitboard bb;
+			bitboard_from_key(s->keys[l][i], s->row_len, s->column_len, s->r, &bb);
+			uint64_t moves = open_moves(&bb);
+			if (moves == 0) {
+				s->values[l][i] = (bb.moves == s->row_len * s->column_len) ? TB_DRAW : TB_WIN;
+				continue;
+			}
+
+			int best = TB_LOSS;
+			while (moves && best != TB_WIN) {
+				uint64_t cell = moves & -moves;
+				bitboard child = bb;
+				play_cell(&child, cell);
+				int64_t index = find_key(s->keys[l+1], s->counts[l+1], bitboard_canonical_key(&child, NULL));
+				if (index < 0) {
+					error("solve: child position missing from next ply");
+				}
+				int value = TB_WIN + TB_LOSS - s->values[l+1][index];
+				if (value > best)
+					best = value;
+				moves ^= cell;
+			}
+			s->values[l][i] = best;
+		}
+	}
+	return s->values[0][0];
+}
+
+/**
+ * Writes the merged layers as a tablebase, so the book can be loaded with
+ * --tablebase. Plies below the split are left empty.
+ * @param s: the merged split
+ * @param path: the file to write
+ * @return 0 on success, 1 on failure
+ */
+int write_book(split* s, const char* path)
+{
+	return tb_write(path, s->row_len, s->column_len, s->r, s->keys, s->values, s->counts);
+}
+
+static void handle_signal(int sig)
+{
+	interrupted = 1;
+}
+
+/**
+ * Turns on checkpoints. SIGINT and SIGTERM then stop the solve after
+ * writing one, so preempted hosts lose no finished units; a local solve
+ * abandons the unit in progress within a few thousand nodes.
+ * @param path: the checkpoint file, NULL to turn checkpoints off
+ * @param interval: seconds between checkpoints
+ * @param resume: non-zero to continue from the file if it exists
+ */
+void set_checkpoint(const char* path, int interval, int resume)
+{
+	checkpoint_path = path;
+	checkpoint_interval = interval;
+	resume_checkpoint = resume;
+	if (path == NULL)
+		return;
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = handle_signal;
+	// No SA_RESTART, so a coordinator blocked in poll() wakes up
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+}
+
+/**
+ * Writes the units and, for local solves, the solver's table. The file
+ * is written beside the checkpoint and renamed over it, so an
+ * interruption while writing leaves the previous checkpoint intact.
+ * @param s: the split
+ * @param sv: the solver whose table to keep, or NULL
+ * @return 0 on success, 1 on failure
+ */
+static int save_checkpoint(split* s, solver* sv)
+{
+	char tmp[4096];
+	snprintf(tmp, sizeof(tmp), "%s.tmp", checkpoint_path);
+	FILE* out = fopen(tmp, "wb");
+	if (out == NULL)
+		return 1;
+
+	checkpoint_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CHECKPOINT_MAGIC, 4);
+	header.version = CHECKPOINT_VERSION;
+	header.row_len = s->row_len;
+	header.column_len = s->column_len;
+	header.r = s->r;
+	header.ply = s->ply;
+	header.num_units = s->num_units;
+	header.table_bits = (sv != NULL) ? sv->table_bits : 0;
+
+	int failed = fwrite(&header, sizeof(header), 1, out) != 1 ||
+			fwrite(s->units, sizeof(work_unit), s->num_units, out) != s->num_units;
+	if (sv != NULL && !failed) {
+		size_t entries = (size_t) 1 << sv->table_bits;
+		failed = fwrite(sv->table, sizeof(solve_entry), entries, out) != entries;
+	}
+	failed |= fflush(out) != 0 || fsync(fileno(out)) != 0;
+	failed |= fclose(out) != 0;
+	if (failed || rename(tmp, checkpoint_path) != 0) {
+		unlink(tmp);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Restores the finished units and, when the sizes match, the solver's
+ * table. Units that were running are solved again.
+ * @param s: the split
+ * @param sv: the solver whose table to restore, or NULL
+ * @return 0 on success, -1 if there is no checkpoint, 1 if it is unusable
+ */
+static int load_checkpoint(split* s, solver* sv)
+{
+	FILE* in = fopen(checkpoint_path, "rb");
+	if (in == NULL)
+		return (errno == ENOENT) ? -1 : 1;
+
+	checkpoint_header header;
+	if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, CHECKPOINT_MAGIC, 4) != 0 ||
+			header.version != CHECKPOINT_VERSION || header.row_len != (uint32_t) s->row_len ||
+			header.column_len != (uint32_t) s->column_len || header.r != (uint32_t) s->r ||
+			header.ply != (uint32_t) s->ply || header.num_units != s->num_units) {
+		fclose(in);
+		return 1;
+	}
+
+	work_unit* units = malloc(sizeof(work_unit) * (s->num_units + 1));
+	uint64_t i;
+	if (fread(units, sizeof(work_unit), s->num_units, in) != s->num_units) {
+		free(units);
+		fclose(in);
+		return 1;
+	}
+	for (i = 0; i < s->num_units; i++) {
+		if (units[i].key != s->units[i].key) {
+			free(units);
+			fclose(in);
+			return 1;
+		}
+		if (units[i].state == UNIT_DONE)
+			finish_unit(s, i, units[i].value, units[i].nodes);
+	}
+	free(units);
+
+	// The table only speeds things up, so a missing one is not an error
+	if (sv != NULL && header.table_bits == (uint32_t) sv->table_bits) {
+		size_t entries = (size_t) 1 << sv->table_bits;
+		if (fread(sv->table, sizeof(solve_entry), entries, in) != entries)
+			memset(sv->table, 0, sizeof(solve_entry) * entries);
+	}
+	fclose(in);
+	return 0;
+}
+
+/**
+ * Resumes from the checkpoint when asked to.
+ */
+static void resume(split* s, solver* sv)
+{
+	if (checkpoint_path == NULL || !resume_checkpoint)
+		return;
+	int status = load_checkpoint(s, sv);
+	if (status > 0) { error("Checkpoint does not belong to this solve"); }
+	if (status == 0) {
+		printf("Resumed: %llu of %llu units already solved\n",
+				(unsigned long long) s->num_done, (unsigned long long) s->num_units);
+		fflush(stdout);
+	}
+}
+
+/**
+ * Returns the monotonic clock in seconds.
+ */
+static double now_s(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/**
+ * Writes a checkpoint when one is due, or when forced.
+ * @param last: time of the previous checkpoint, updated
+ */
+static void checkpoint(split* s, solver* sv, double* last, int force)
+{
+	if (checkpoint_path == NULL || (!force && now_s() - *last < checkpoint_interval))
+		return;
+	if (save_checkpoint(s, sv) != 0) {
+		printf("Could not write checkpoint %s\n", checkpoint_path);
+		fflush(stdout);
+	}
+	*last = now_s();
+}
+
+/**
+ * Solves every pending unit in this process with one solver, so later
+ * units reuse the table entries of earlier ones.
+ * @param s: the split
+ * @return 0 when every unit is done, 2 when interrupted
+ */
+int solve_units(split* s)
+{
+	solver* sv = create_solver(s->row_len, s->column_len, s->r, SOLVE_TABLE_BITS);
+	double last = now_s();
+	uint64_t i;
+
+	// A signal abandons the unit being solved, which stays pending
+	sv->stop = &interrupted;
+	resume(s, sv);
+	for (i = 0; i < s->num_units && !interrupted; i++) {
+		work_unit* u = &s->units[i];
+		if (u->state == UNIT_DONE)
+			continue;
+		long before = sv->nodes;
+		int value = solve_key(sv, u->key, u->alpha, u->beta);
+		if (sv->aborted)
+			break;
+		finish_unit(s, i, value, sv->nodes - before);
+		checkpoint(s, sv, &last, 0);
+	}
+	checkpoint(s, sv, &last, 1);
+	delete_solver(sv);
+	return interrupted ? 2 : 0;
+}
+
+/*
+ * Sockets. Addresses are "unix:PATH" or "HOST:PORT"; an empty host
+ * listens on every interface. The protocol is one text line per message:
+ *
+ *   worker -> coordinator   HELLO rows cols r
+ *                           RESULT key value nodes
+ *   coordinator -> worker   SOLVE key alpha beta
+ *                           DONE | BYE
+ */
+
+/**
+ * Resolves an address and creates a socket for it.
+ * @param address: the address
+ * @param passive: non-zero to bind and listen, zero to connect
+ * @return the socket, or -1
+ */
+static int open_socket(const char* address, int passive)
+{
+	int fd;
+
+	if (strncmp(address, "unix:", 5) == 0) {
+		struct sockaddr_un sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sun_family = AF_UNIX;
+		if (strlen(address + 5) >= sizeof(sa.sun_path))
+			return -1;
+		strcpy(sa.sun_path, address + 5);
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0)
+			return -1;
+		if (passive) {
+			unlink(sa.sun_path);
+			if (bind(fd, (struct sockaddr*) &sa, sizeof(sa)) == 0 && listen(fd, MAX_WORKERS) == 0)
+				return fd;
+		} else if (connect(fd, (struct sockaddr*) &sa, sizeof(sa)) == 0) {
+			return fd;
+		}
+		close(fd);
+		return -1;
+	}
+
+	char host[256];
+	const char* colon = strrchr(address, ':');
+	if (colon == NULL || (size_t) (colon - address) >= sizeof(host))
+		return -1;
+	memcpy(host, address, colon - address);
+	host[colon - address] = '\0';
+
+	struct addrinfo hints, *res, *ai;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = passive ? AI_PASSIVE : 0;
+	if (getaddrinfo(host[0] ? host : NULL, colon + 1, &hints, &res) != 0)
+		return -1;
+
+	fd = -1;
+	for (ai = res; ai != NULL && fd < 0; ai = ai->ai_next) {
+		fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (fd < 0)
+			continue;
+		if (passive) {
+			int on = 1;
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+			if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, MAX_WORKERS) == 0)
+				break;
+		} else if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+			break;
+		}
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	return fd;
+}
+
+/**
+ * Sends one formatted line.
+ * @return 0 on success, -1 if the peer has gone
+ */
+static int send_line(int fd, const char* format, ...)
+{
+	char line[128];
+	va_list args;
+	va_start(args, format);
+	int len = vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+
+	int sent = 0;
+	while (sent < len) {
+		ssize_t n = send(fd, line + sent, len - sent, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		sent += n;
+	}
+	return 0;
+}
+
+/*
+ * A connected worker, as seen by the coordinator
+ */
+typedef struct worker_conn {
+	int fd;
+	int ready;          /* sent a HELLO for this board */
+	int64_t unit;       /* unit being solved, -1 when idle */
+	double started;     /* when the unit was sent */
+	int len;
+	char buf[256];
+} worker_conn;
+
+/**
+ * Counts the connected workers solving a unit.
+ */
+static int unit_holders(worker_conn* workers, int num_workers, int64_t unit)
+{
+	int i, holders = 0;
+	for (i = 0; i < num_workers; i++) {
+		holders += (workers[i].fd >= 0 && workers[i].unit == unit);
+	}
+	return holders;
+}
+
+/**
+ * Returns the running unit that has been with a single worker longest,
+ * once past UNIT_DEADLINE, or -1. The worker may be stalled on a host
+ * whose connection stays up, so the unit goes to an idle worker as well
+ * and the first result counts.
+ */
+static int64_t stalled_unit(split* s, worker_conn* workers, int num_workers, double now)
+{
+	int64_t stalled = -1;
+	double oldest = now - UNIT_DEADLINE;
+	int i;
+	for (i = 0; i < num_workers; i++) {
+		worker_conn* w = &workers[i];
+		if (w->fd < 0 || w->unit < 0 || w->started > oldest ||
+				s->units[w->unit].state != UNIT_RUNNING ||
+				unit_holders(workers, num_workers, w->unit) > 1)
+			continue;
+		stalled = w->unit;
+		oldest = w->started;
+	}
+	return stalled;
+}
+
+/**
+ * Closes a worker's connection and puts its unit back in the queue, unless
+ * another worker is solving it too.
+ */
+static void drop_worker(split* s, worker_conn* workers, int num_workers, worker_conn* w,
+		uint64_t* cursor)
+{
+	close(w->fd);
+	w->fd = -1;
+	if (w->unit >= 0 && s->units[w->unit].state == UNIT_RUNNING &&
+			unit_holders(workers, num_workers, w->unit) == 0) {
+		s->units[w->unit].state = UNIT_PENDING;
+		if ((uint64_t) w->unit < *cursor)
+			*cursor = w->unit;
+		printf("worker lost, unit %lld re-queued\n", (long long) w->unit);
+	}
+}
+
+/**
+ * Handles one line from a worker.
+ * @return 0 to keep the worker, -1 to drop it
+ */
+static int handle_line(split* s, worker_conn* w, const char* line)
+{
+	int rows, cols, r, value;
+	unsigned long long key;
+	long nodes;
+
+	if (sscanf(line, "HELLO %d %d %d", &rows, &cols, &r) == 3) {
+		if (rows != s->row_len || cols != s->column_len || r != s->r) {
+			send_line(w->fd, "BYE\n");
+			return -1;
+		}
+		w->ready = 1;
+		return 0;
+	}
+	if (sscanf(line, "RESULT %llx %d %ld", &key, &value, &nodes) == 3) {
+		if (w->unit < 0 || s->units[w->unit].key != key || value < SOLVE_LOSS || value > SOLVE_WIN)
+			return -1;
+		if (finish_unit(s, w->unit, value, nodes)) {
+			printf("[%llu/%llu] unit %lld: %s, %ld nodes\n",
+					(unsigned long long) s->num_done, (unsigned long long) s->num_units,
+					(long long) w->unit, (value > 0) ? "win" : (value < 0) ? "loss" : "draw", nodes);
+			fflush(stdout);
+		}
+		w->unit = -1;
+		return 0;
+	}
+	return -1;
+}
+
+/**
+ * Returns the next pending unit at or after the cursor, or -1.
+ */
+static int64_t next_pending(split* s, uint64_t* cursor)
+{
+	while (*cursor < s->num_units && s->units[*cursor].state != UNIT_PENDING) {
+		(*cursor)++;
+	}
+	return (*cursor < s->num_units) ? (int64_t) *cursor : -1;
+}
+
+/**
+ * Listens on address and hands each connected worker one unit at a time
+ * until every unit is done. A worker whose connection closes or fails has
+ * its unit re-queued for the next idle worker, and once no units are
+ * pending, one that has run past UNIT_DEADLINE is also given to an idle
+ * worker; workers may join at any time, and the coordinator waits for new
+ * ones if all are lost.
+ * Checkpoints hold the finished units only; workers keep their tables.
+ * @param s: the split
+ * @param address: the address to listen on
+ * @return 0 when all units are done, 1 if the address could not be used,
+ * 2 when interrupted
+ */
+int run_coordinator(split* s, const char* address)
+{
+	int listener = open_socket(address, 1);
+	if (listener < 0)
+		return 1;
+
+	worker_conn workers[MAX_WORKERS];
+	struct pollfd fds[MAX_WORKERS + 1];
+	int num_workers = 0;
+	uint64_t cursor = 0;
+	double last = now_s();
+	int i;
+
+	resume(s, NULL);
+	while (s->num_done < s->num_units && !interrupted) {
+		checkpoint(s, NULL, &last, 0);
+
+		// Give every idle worker a unit
+		for (i = 0; i < num_workers; i++) {
+			worker_conn* w = &workers[i];
+			if (!w->ready || w->unit >= 0)
+				continue;
+			int64_t index = next_pending(s, &cursor);
+			if (index < 0)
+				index = stalled_unit(s, workers, num_workers, now_s());
+			if (index < 0)
+				break;
+			work_unit* u = &s->units[index];
+			if (u->state == UNIT_RUNNING) {
+				printf("unit %lld running for over %d s, also sent to another worker\n",
+						(long long) index, UNIT_DEADLINE);
+				fflush(stdout);
+			}
+			w->unit = index;
+			w->started = now_s();
+			u->state = UNIT_RUNNING;
+			if (send_line(w->fd, "SOLVE %llx %d %d\n", (unsigned long long) u->key, u->alpha, u->beta) != 0)
+				drop_worker(s, workers, num_workers, w, &cursor);
+		}
+
+		// Forget closed connections
+		int kept = 0;
+		for (i = 0; i < num_workers; i++) {
+			if (workers[i].fd >= 0)
+				workers[kept++] = workers[i];
+		}
+		num_workers = kept;
+
+		fds[0].fd = listener;
+		fds[0].events = POLLIN;
+		for (i = 0; i < num_workers; i++) {
+			fds[i+1].fd = workers[i].fd;
+			fds[i+1].events = POLLIN;
+		}
+		// Wake up for checkpoints, and to look for stalled units
+		int timeout = (checkpoint_path != NULL) ? checkpoint_interval * 1000 : -1;
+		if (num_workers > 0 && (timeout < 0 || timeout > UNIT_DEADLINE * 1000))
+			timeout = UNIT_DEADLINE * 1000;
+		if (poll(fds, num_workers + 1, timeout) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (i = 0; i < num_workers; i++) {
+			worker_conn* w = &workers[i];
+			if (fds[i+1].revents == 0)
+				continue;
+			ssize_t n = read(w->fd, w->buf + w->len, sizeof(w->buf) - 1 - w->len);
+			if (n <= 0) {
+				drop_worker(s, workers, num_workers, w, &cursor);
+				continue;
+			}
+			w->len += n;
+			w->buf[w->len] = '\0';
+
+			char* newline;
+			while (w->fd >= 0 && (newline = strchr(w->buf, '\n')) != NULL) {
+				*newline = '\0';
+				if (handle_line(s, w, w->buf) != 0) {
+					drop_worker(s, workers, num_workers, w, &cursor);
+					break;
+				}
+				w->len -= newline + 1 - w->buf;
+				memmove(w->buf, newline + 1, w->len + 1);
+			}
+			// A full buffer without a newline is not a worker
+			if (w->fd >= 0 && w->len == (int) sizeof(w->buf) - 1)
+				drop_worker(s, workers, num_workers, w, &cursor);
+		}
+
+		if (fds[0].revents & POLLIN) {
+			int fd = accept(listener, NULL, NULL);
+			if (fd >= 0 && num_workers < MAX_WORKERS) {
+				int on = 1, idle = KEEPALIVE_IDLE, interval = KEEPALIVE_INTERVAL, count = KEEPALIVE_COUNT;
+				// Lets the kernel notice workers on hosts that went away within
+				// a couple of minutes, not the system default of hours; the
+				// TCP options fail harmlessly on Unix sockets
+				setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+				setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+				setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+				setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+				workers[num_workers].fd = fd;
+				workers[num_workers].ready = 0;
+				workers[num_workers].unit = -1;
+				workers[num_workers].len = 0;
+				num_workers++;
+			} else if (fd >= 0) {
+				close(fd);
+			}
+		}
+	}
+
+	for (i = 0; i < num_workers; i++) {
+		if (workers[i].fd >= 0) {
+			send_line(workers[i].fd, "DONE\n");
+			close(workers[i].fd);
+		}
+	}
+	close(listener);
+	if (strncmp(address, "unix:", 5) == 0)
+		unlink(address + 5);
+	checkpoint(s, NULL, &last, 1);
+	if (interrupted)
+		return 2;
+	return (s->num_done == s->num_units) ? 0 : 1;
+}
+
+/**
+ * Connects to a coordinator and solves the units it sends until it says
+ * it is done. The connection is retried for a few seconds so workers can
+ * be started before the coordinator.
+ * @param address: the coordinator's address
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ * @param r: number of checkers in a row needed to win
+ * @return 0 when the coordinator finished, 1 otherwise
+ */
+int run_worker(const char* address, int num_rows, int num_cols, int r)
+{
+	int fd = -1, attempt;
+	for (attempt = 0; attempt < 50 && fd < 0; attempt++) {
+		fd = open_socket(address, 0);
+		if (fd < 0)
+			usleep(100000);
+	}
+	if (fd < 0)
+		return 1;
+
+	FILE* in = fdopen(fd, "r");
+	solver* sv = create_solver(num_rows, num_cols, r, SOLVE_TABLE_BITS);
+	char line[256];
+	int status = 1;
+
+	if (send_line(fd, "HELLO %d %d %d\n", num_rows, num_cols, r) == 0) {
+		while (fgets(line, sizeof(line), in) != NULL) {
+			unsigned long long key;
+			int alpha, beta;
+			if (sscanf(line, "SOLVE %llx %d %d", &key, &alpha, &beta) == 3) {
+				long before = sv->nodes;
+				int value = solve_key(sv, key, alpha, beta);
+				if (send_line(fd, "RESULT %llx %d %ld\n", key, value, sv->nodes - before) != 0)
+					break;
+			} else {
+				status = (strncmp(line, "DONE", 4) == 0) ? 0 : 1;
+				break;
+			}
+		}
+	}
+
+	delete_solver(sv);
+	fclose(in);
+	return status;
+}
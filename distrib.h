@@ -0,0 +1,99 @@
+/*
+ * distrib.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+#ifndef DISTRIB_H_
+#define DISTRIB_H_
+#include <stdint.h>
+
+/* Unit states */
+#define UNIT_PENDING 0
+#define UNIT_RUNNING 1
+#define UNIT_DONE 2
+
+/* Ply at which the tree is split when none is given */
+#define SPLIT_DEFAULT_PLY 4
+/* Most workers a coordinator serves at once */
+#define MAX_WORKERS 64
+/* Seconds a unit may run before an idle worker is given it as well */
+#define UNIT_DEADLINE 600
+/* Seconds a TCP connection to a worker may be silent before it is probed,
+ * and between probes, and the number of failed probes that close it */
+#define KEEPALIVE_IDLE 60
+#define KEEPALIVE_INTERVAL 10
+#define KEEPALIVE_COUNT 6
+/* Seconds between checkpoints when none is given */
+#define CHECKPOINT_DEFAULT_INTERVAL 60
+
+#define CHECKPOINT_MAGIC "C4CP"
+#define CHECKPOINT_VERSION 1
+
+/*
+ * A work unit: one position at the split ply, solved within a window.
+ */
+typedef struct work_unit {
+	uint64_t key;
+	int8_t alpha;
+	int8_t beta;
+	int8_t value;
+	uint8_t state;
+	long nodes;
+} work_unit;
+
+/*
+ * The game tree down to the split ply, one layer of sorted canonical keys
+ * and TB_* values per ply (the tablebase layout), and the work units made
+ * from the last layer.
+ */
+typedef struct split {
+	int row_len;
+	int column_len;
+	int r;
+	int ply;
+	uint64_t** keys;
+	unsigned char** values;
+	uint64_t* counts;
+	work_unit* units;
+	uint64_t num_units;
+	uint64_t num_done;
+} split;
+
+split* create_split(int num_rows, int num_cols, int r, int ply);
+void delete_split(split* s);
+/* Record a unit's result; returns 1 if it was not already done */
+int finish_unit(split* s, uint64_t index, int value, long nodes);
+/* Values from the units up to the empty board; returns its TB_* value */
+int merge_split(split* s);
+/* Write the merged layers as a tablebase */
+int write_book(split* s, const char* path);
+
+/*
+ * Checkpoint file: header, one work_unit per unit, then the solver's table
+ * when table_bits is non-zero (local solves only).
+ */
+typedef struct checkpoint_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t row_len;
+	uint32_t column_len;
+	uint32_t r;
+	uint32_t ply;
+	uint64_t num_units;
+	uint32_t table_bits;
+	uint32_t reserved;
+} checkpoint_header;
+
+/* Checkpoint to path every interval seconds, resuming from it first if
+ * resume is set; a NULL path turns checkpoints off */
+void set_checkpoint(const char* path, int interval, int resume);
+
+/* Solve every unit in this process; 0 when done, 2 when interrupted */
+int solve_units(split* s);
+/* Hand units to workers connecting on address until all are done; 0 when
+ * done, 1 if the address is unusable, 2 when interrupted */
+int run_coordinator(split* s, const char* address);
+/* Solve units for the coordinator at address until it is done */
+int run_worker(const char* address, int num_rows, int num_cols, int r);
+
+#endif /* DISTRIB_H_ */
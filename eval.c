@@ -0,0 +1,251 @@
+#include <stdint.h>
+#include <string.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include "bitboard.h"
+#include "eval.h"
+
+/**
+ * Prepares an evaluator for an n x m connect-r board that fits in a
+ * bitboard. The AVX2 path is used when the processor supports it.
+ * @param e: the evaluator to fill
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ * @param r: number of checkers in a row needed to win
+ * @param win_score: score of a completed line for player 1
+ */
+void eval_init(evaluator* e, int num_rows, int num_cols, int r, int win_score)
+{
+	int h = num_rows + 1;
+	e->cells = bottom_mask(num_rows, num_cols) * (((uint64_t) 1 << num_rows) - 1);
+	e->row_len = num_rows;
+	e->column_len = num_cols;
+	e->r = r;
+	e->levels = (r - 1 < EVAL_LEVELS) ? r - 1 : EVAL_LEVELS;
+	e->dirs[0] = 1;
+	e->dirs[1] = h;
+	e->dirs[2] = h - 1;
+	e->dirs[3] = h + 1;
+	e->win_score = win_score;
+#if defined(__x86_64__)
+	e->avx2 = __builtin_cpu_supports("avx2");
+#else
+	e->avx2 = 0;
+#endif
+}
+
+/**
+ * Turns the raw line scores of both players into a search score.
+ */
+static int finish(evaluator* e, int64_t own, int64_t opponent, int won, int lost)
+{
+	if (won)
+		return e->win_score;
+	if (lost)
+		return -e->win_score;
+	int64_t score = (own - opponent) / EVAL_SCALE;
+	if (score >= e->win_score)
+		score = e->win_score - 1;
+	else if (score <= -e->win_score)
+		score = -e->win_score + 1;
+	return score;
+}
+
+/**
+ * Shifts x right by n bits, clearing it when n is as wide as the word.
+ */
+static uint64_t shift_down(uint64_t x, int n)
+{
+	return (n >= 64) ? 0 : x >> n;
+}
+
+/**
+ * Returns the raw line score of stones against the opponent's checkers and
+ * sets *won when stones hold a completed line. Bit c of a window mask
+ * stands for the line of r cells starting at c in the given direction.
+ */
+static int64_t line_score(evaluator* e, uint64_t stones, uint64_t opponent, int* won)
+{
+	uint64_t open_cells = e->cells & ~opponent;
+	int64_t score = 0;
+	int d, i, k;
+
+	*won = 0;
+	for (d = 0; d < 4; d++) {
+		uint64_t open = ~(uint64_t) 0, full = ~(uint64_t) 0;
+		uint64_t level[EVAL_LEVELS + 1] = { 0 };
+		for (i = 0; i < e->r; i++) {
+			uint64_t s = shift_down(stones, i * e->dirs[d]);
+			open &= shift_down(open_cells, i * e->dirs[d]);
+			full &= s;
+			// level[k] marks windows holding at least k of the stones seen
+			for (k = e->levels; k > 1; k--)
+				level[k] |= level[k-1] & s;
+			level[1] |= s;
+		}
+		*won |= (full != 0);
+		for (k = 1; k <= e->levels; k++)
+			score += (int64_t) __builtin_popcountll(open & level[k]) << (k - 1);
+	}
+	return score;
+}
+
+/**
+ * Scores positions one at a time.
+ */
+static void eval_scalar(evaluator* e, const uint64_t* p1, const uint64_t* mask, int* scores, int count)
+{
+	int i;
+	for (i = 0; i < count; i++) {
+		int won, lost;
+		uint64_t p2 = p1[i] ^ mask[i];
+		int64_t own = line_score(e, p1[i], p2, &won);
+		int64_t opponent = line_score(e, p2, p1[i], &lost);
+		scores[i] = finish(e, own, opponent, won, lost);
+	}
+}
+
+#if defined(__x86_64__)
+/**
+ * Counts the set bits of each 64-bit lane by looking up every nibble.
+ */
+__attribute__((target("avx2")))
+static __m256i popcount_avx2(__m256i x)
+{
+	const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+	__m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(x, nibble));
+	__m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi64(x, 4), nibble));
+	return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+/**
+ * Vector form of line_score() for four positions, one per lane. Shift
+ * counts of 64 or more clear a lane, as the scalar code does explicitly.
+ */
+__attribute__((target("avx2")))
+static __m256i line_score_avx2(evaluator* e, __m256i stones, __m256i opponent, __m256i* won)
+{
+	const __m256i ones = _mm256_set1_epi64x(-1);
+	__m256i open_cells = _mm256_andnot_si256(opponent, _mm256_set1_epi64x(e->cells));
+	__m256i score = _mm256_setzero_si256();
+	__m256i any = _mm256_setzero_si256();
+	int d, i, k;
+
+	for (d = 0; d < 4; d++) {
+		__m256i open = ones, full = ones;
+		__m256i level[EVAL_LEVELS + 1];
+		for (k = 0; k <= EVAL_LEVELS; k++)
+			level[k] = _mm256_setzero_si256();
+		for (i = 0; i < e->r; i++) {
+			__m128i n = _mm_cvtsi32_si128(i * e->dirs[d]);
+			__m256i s = _mm256_srl_epi64(stones, n);
+			open = _mm256_and_si256(open, _mm256_srl_epi64(open_cells, n));
+			full = _mm256_and_si256(full, s);
+			for (k = e->levels; k > 1; k--)
+				level[k] = _mm256_or_si256(level[k], _mm256_and_si256(level[k-1], s));
+			level[1] = _mm256_or_si256(level[1], s);
+		}
+		any = _mm256_or_si256(any, full);
+		for (k = 1; k <= e->levels; k++) {
+			__m256i count = popcount_avx2(_mm256_and_si256(open, level[k]));
+			score = _mm256_add_epi64(score, _mm256_slli_epi64(count, k - 1));
+		}
+	}
+	*won = any;
+	return score;
+}
+
+/**
+ * Scores positions four at a time, finishing any remainder with the
+ * scalar code.
+ */
+__attribute__((target("avx2")))
+static void eval_avx2(evaluator* e, const uint64_t* p1, const uint64_t* mask, int* scores, int count)
+{
+	int64_t own[4], opponent[4];
+	uint64_t won[4], lost[4];
+	int i, j;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		__m256i a = _mm256_loadu_si256((const __m256i*) (p1 + i));
+		__m256i b = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i*) (mask + i)));
+		__m256i w, l;
+		_mm256_storeu_si256((__m256i*) own, line_score_avx2(e, a, b, &w));
+		_mm256_storeu_si256((__m256i*) opponent, line_score_avx2(e, b, a, &l));
+		_mm256_storeu_si256((__m256i*) won, w);
+		_mm256_storeu_si256((__m256i*) lost, l);
+		for (j = 0; j < 4; j++)
+			scores[i + j] = finish(e, own[j], opponent[j], won[j] != 0, lost[j] != 0);
+	}
+	eval_scalar(e, p1 + i, mask + i, scores + i, count - i);
+}
+#endif
+
+/**
+ * Scores positions given as structure-of-arrays bitboards, from player 1's
+ * point of view.
+ * @param e: the evaluator
+ * @param p1: player 1's checkers per position
+ * @param mask: occupied cells per position
+ * @param scores: filled with one score per position
+ * @param count: number of positions
+ */
+void eval_positions(evaluator* e, const uint64_t* p1, const uint64_t* mask, int* scores, int count)
+{
+#if defined(__x86_64__)
+	if (e->avx2) {
+		eval_avx2(e, p1, mask, scores, count);
+		return;
+	}
+#endif
+	eval_scalar(e, p1, mask, scores, count);
+}
+
+/**
+ * Scores a single position.
+ * @param e: the evaluator
+ * @param bb: the position
+ */
+int eval_position(evaluator* e, bitboard* bb)
+{
+	int score;
+	eval_scalar(e, &bb->p1, &bb->mask, &score, 1);
+	return score;
+}
+
+/**
+ * Empties a batch.
+ * @param batch: the batch
+ */
+void eval_batch_clear(eval_batch* batch)
+{
+	batch->count = 0;
+}
+
+/**
+ * Appends a position to a batch.
+ * @param batch: the batch
+ * @param bb: the position
+ * @return the position's index in the batch, or -1 when the batch is full
+ */
+int eval_batch_add(eval_batch* batch, bitboard* bb)
+{
+	if (batch->count == EVAL_BATCH)
+		return -1;
+	batch->p1[batch->count] = bb->p1;
+	batch->mask[batch->count] = bb->mask;
+	return batch->count++;
+}
+
+/**
+ * Scores every position in a batch into its score array.
+ * @param e: the evaluator
+ * @param batch: the batch
+ */
+void eval_batch_run(evaluator* e, eval_batch* batch)
+{
+	eval_positions(e, batch->p1, batch->mask, batch->score, batch->count);
+}
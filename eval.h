@@ -0,0 +1,62 @@
+/*
+ * eval.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+#ifndef EVAL_H_
+#define EVAL_H_
+#include <stdint.h>
+#include "bitboard.h"
+
+/* Leaf evaluators */
+#define EVAL_HEURISTIC 0  /* get_best_max / get_best_min */
+#define EVAL_BITBOARD 1   /* open-line count, batched */
+#define EVAL_NN 2         /* quantized network, see nnue.h */
+
+/* Positions per batch; enough for every child of a node */
+#define EVAL_BATCH 64
+/* Stone counts per line that are weighed, 1 up to EVAL_LEVELS */
+#define EVAL_LEVELS 3
+/* Raw line score per point of final score */
+#define EVAL_SCALE 4
+
+/*
+ * Scores positions by their open lines: every run of r cells holding
+ * checkers of only one player counts for that player, with weight 1, 3 or
+ * 7 as it holds 1, 2 or 3 or more checkers. Completed lines score
+ * +/-win_score; other scores are scaled and clamped inside the open range.
+ */
+typedef struct evaluator {
+	uint64_t cells;         /* every cell of the board */
+	int row_len;
+	int column_len;
+	int r;
+	int levels;             /* EVAL_LEVELS, or r - 1 when smaller */
+	int dirs[4];            /* bit distance between neighbours per direction */
+	int win_score;
+	int avx2;
+} evaluator;
+
+/* Positions laid out as structure-of-arrays for vector evaluation */
+typedef struct eval_batch {
+	int count;
+	uint64_t p1[EVAL_BATCH] __attribute__((aligned(32)));
+	uint64_t mask[EVAL_BATCH] __attribute__((aligned(32)));
+	int score[EVAL_BATCH];
+} eval_batch;
+
+void eval_init(evaluator* e, int num_rows, int num_cols, int r, int win_score);
+/* Score count positions given as separate p1 and mask arrays */
+void eval_positions(evaluator* e, const uint64_t* p1, const uint64_t* mask, int* scores, int count);
+/* Score a single position */
+int eval_position(evaluator* e, bitboard* bb);
+
+/*
+ * Batch functions
+ */
+void eval_batch_clear(eval_batch* batch);
+/* Append a position; returns its index, or -1 when the batch is full */
+int eval_batch_add(eval_batch* batch, bitboard* bb);
+void eval_batch_run(evaluator* e, eval_batch* batch);
+
+#endif /* EVAL_H_ */
@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
+#include "gamelog.h"
+
+/**
+ * Starts recording a game.
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ * @param r: number of checkers in a row needed to win
+ * @return the record, to be submitted or discarded
+ */
+gl_record* gamelog_begin(int num_rows, int num_cols, int r)
+{
+	gl_record* rec = (gl_record*) calloc(1, sizeof(gl_record));
+	rec->game.row_len = num_rows;
+	rec->game.column_len = num_cols;
+	rec->game.r = r;
+	rec->capacity = num_rows * num_cols;
+	rec->moves = (gl_move*) calloc(rec->capacity, sizeof(gl_move));
+	return rec;
+}
+
+/**
+ * Appends a move to the game being recorded.
+ * @param rec: the record
+ * @param column: the column played
+ * @param player: the player who moved
+ * @param score: the engine's score for the move
+ * @param depth: the depth searched, 0 when the move was not searched
+ * @param nodes: the nodes searched
+ * @param time_us: the time taken, in microseconds
+ */
+void gamelog_move(gl_record* rec, int column, int player, int score, int depth,
+		long nodes, long time_us)
+{
+	if (rec->game.num_moves == rec->capacity) {
+		rec->capacity = rec->capacity * 2 + 1;
+		rec->moves = (gl_move*) realloc(rec->moves, sizeof(gl_move) * rec->capacity);
+	}
+	gl_move* m = &rec->moves[rec->game.num_moves++];
+	memset(m, 0, sizeof(gl_move));
+	m->column = column;
+	m->player = player;
+	m->score = score;
+	m->depth = depth;
+	m->nodes = (nodes > UINT32_MAX) ? UINT32_MAX : nodes;
+	m->time_us = (time_us > UINT32_MAX) ? UINT32_MAX : time_us;
+}
+
+/**
+ * Deallocates a record without writing it.
+ * @param rec: the record
+ */
+void gamelog_discard(gl_record* rec)
+{
+	free(rec->moves);
+	free(rec);
+}
+
+/**
+ * FNV-1a over a game as laid out in the file, after its sync and checksum.
+ */
+static uint32_t game_checksum(const unsigned char* game, size_t length)
+{
+	size_t skip = offsetof(gl_game, num_moves);
+	uint32_t h = 0x811c9dc5u;
+	for (size_t i = skip; i < length; i++)
+		h = (h ^ game[i]) * 0x01000193u;
+	return h;
+}
+
+/**
+ * Appends a game to the log with a single write.
+ */
+static void write_record(int fd, gl_record* rec)
+{
+	size_t moves = sizeof(gl_move) * rec->game.num_moves;
+	size_t length = sizeof(gl_game) + moves;
+	unsigned char* buf = malloc(length);
+	rec->game.sync = GL_SYNC;
+	rec->game.checksum = 0;
+	memcpy(buf, &rec->game, sizeof(gl_game));
+	memcpy(buf + sizeof(gl_game), rec->moves, moves);
+	((gl_game*) buf)->checksum = game_checksum(buf, length);
+	if (write(fd, buf, length) != (ssize_t) length)
+		perror("gamelog");
+	free(buf);
+}
+
+/**
+ * Writer thread: appends submitted games until the log is closed.
+ */
+static void* writer_main(void* arg)
+{
+	gamelog_writer* w = (gamelog_writer*) arg;
+
+	pthread_mutex_lock(&w->lock);
+	while (1) {
+		while (w->head == NULL && !w->closing)
+			pthread_cond_wait(&w->ready, &w->lock);
+		if (w->head == NULL && w->closing)
+			break;
+
+		gl_record* rec = w->head;
+		w->head = NULL;
+		w->tail = NULL;
+		pthread_mutex_unlock(&w->lock);
+
+		// Write outside the lock so the play loop never waits on the disk
+		while (rec != NULL) {
+			gl_record* next = rec->next;
+			uint64_t start = trace_begin();
+			write_record(w->fd, rec);
+			trace_end_arg("write game", "log", start, "moves", rec->game.num_moves);
+			gamelog_discard(rec);
+			rec = next;
+		}
+		pthread_mutex_lock(&w->lock);
+	}
+	pthread_mutex_unlock(&w->lock);
+	return NULL;
+}
+
+/**
+ * Opens a log for appending, creating it if needed, and starts the writer
+ * thread.
+ * @param path: the log file
+ * @return the writer, or NULL if the file could not be opened or is not a log
+ */
+gamelog_writer* gamelog_create(const char* path)
+{
+	int fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+	if (fd < 0)
+		return NULL;
+
+	// Another run may be creating the same log; only one writes the header
+	gl_file header;
+	struct stat st;
+	if (flock(fd, LOCK_EX) != 0 || fstat(fd, &st) != 0) {
+		close(fd);
+		return NULL;
+	}
+	if (st.st_size == 0) {
+		memcpy(header.magic, GL_MAGIC, 4);
+		header.version = GL_VERSION;
+		if (write(fd, &header, sizeof(header)) != sizeof(header)) {
+			close(fd);
+			return NULL;
+		}
+	} else if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+			memcmp(header.magic, GL_MAGIC, 4) != 0 || header.version != GL_VERSION) {
+		close(fd);
+		return NULL;
+	}
+	flock(fd, LOCK_UN);
+
+	gamelog_writer* w = (gamelog_writer*) calloc(1, sizeof(gamelog_writer));
+	w->fd = fd;
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->ready, NULL);
+	pthread_create(&w->thread, NULL, writer_main, w);
+	return w;
+}
+
+/**
+ * Queues a finished game for the writer thread.
+ * @param w: the writer
+ * @param rec: the record, owned by the writer from now on
+ * @param winner: 1 or 2, or 0 for a draw
+ */
+void gamelog_submit(gamelog_writer* w, gl_record* rec, int winner)
+{
+	rec->game.winner = winner;
+	rec->next = NULL;
+	pthread_mutex_lock(&w->lock);
+	if (w->tail == NULL)
+		w->head = rec;
+	else
+		w->tail->next = rec;
+	w->tail = rec;
+	pthread_cond_signal(&w->ready);
+	pthread_mutex_unlock(&w->lock);
+}
+
+/**
+ * Waits for every queued game to be written, then closes the log.
+ * @param w: the writer
+ */
+void gamelog_close(gamelog_writer* w)
+{
+	if (w == NULL)
+		return;
+	pthread_mutex_lock(&w->lock);
+	w->closing = 1;
+	pthread_cond_signal(&w->ready);
+	pthread_mutex_unlock(&w->lock);
+	pthread_join(w->thread, NULL);
+
+	close(w->fd);
+	pthread_mutex_destroy(&w->lock);
+	pthread_cond_destroy(&w->ready);
+	free(w);
+}
+
+/**
+ * Memory-maps a log for reading.
+ * @param path: the log file
+ * @return the reader, positioned at the first game, or NULL
+ */
+gamelog_reader* gamelog_open(const char* path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(gl_file)) {
+		close(fd);
+		return NULL;
+	}
+	void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return NULL;
+
+	const gl_file* header = (const gl_file*) data;
+	if (memcmp(header->magic, GL_MAGIC, 4) != 0 || header->version != GL_VERSION) {
+		munmap(data, st.st_size);
+		return NULL;
+	}
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+	gamelog_reader* r = (gamelog_reader*) malloc(sizeof(gamelog_reader));
+	r->data = data;
+	r->length = st.st_size;
+	r->offset = sizeof(gl_file);
+	return r;
+}
+
+/**
+ * Advances to the next game. The pointers refer directly into the mapped
+ * file and stay valid until the reader is released. A game cut short by a
+ * crash mid-write fails its checksum and is skipped: the reader scans on
+ * to the next GL_SYNC, so games appended after it are still read.
+ * @param r: the reader
+ * @param game: set to the game header
+ * @param moves: set to the game's moves
+ * @return 1 when a game was read, 0 at the end of the log
+ */
+int gamelog_next(gamelog_reader* r, const gl_game** game, const gl_move** moves)
+{
+	for (; r->offset + sizeof(gl_game) <= r->length; r->offset++) {
+		const gl_game* g = (const gl_game*) (r->data + r->offset);
+		if (g->sync != GL_SYNC)
+			continue;
+		size_t length = sizeof(gl_game) + sizeof(gl_move) * g->num_moves;
+		if (r->offset + length > r->length ||
+				g->checksum != game_checksum(r->data + r->offset, length))
+			continue;
+
+		*game = g;
+		*moves = (const gl_move*) (r->data + r->offset + sizeof(gl_game));
+		r->offset += length;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Moves the reader back to the first game.
+ * @param r: the reader
+ */
+void gamelog_rewind(gamelog_reader* r)
+{
+	r->offset = sizeof(gl_file);
+}
+
+/**
+ * Unmaps and deallocates a reader.
+ * @param r: the reader
+ */
+void gamelog_release(gamelog_reader* r)
+{
+	if (r == NULL)
+		return;
+	munmap((void*) r->data, r->length);
+	free(r);
+}
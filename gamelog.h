@@ -0,0 +1,101 @@
+/*
+ * gamelog.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+#ifndef GAMELOG_H_
+#define GAMELOG_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define GL_MAGIC "C4GL"
+#define GL_VERSION 2
+/* First field of every game, where a reader resumes after a damaged one */
+#define GL_SYNC 0x47344347u
+
+/*
+ * A log is a gl_file header followed by games, each a gl_game followed by
+ * num_moves gl_moves. Games are only ever appended, one write per game;
+ * each starts with GL_SYNC and carries a checksum, so a game cut short by
+ * a crash can be recognised and stepped over.
+ */
+typedef struct gl_file {
+	char magic[4];
+	uint32_t version;
+} gl_file;
+
+typedef struct gl_game {
+	uint32_t sync;        /* GL_SYNC */
+	uint32_t checksum;    /* FNV-1a of the rest of the game and its moves */
+	uint16_t num_moves;
+	uint8_t row_len;
+	uint8_t column_len;
+	uint8_t r;
+	int8_t winner;        /* 1 or 2, 0 for a draw */
+	uint16_t reserved;
+} gl_game;
+
+typedef struct gl_move {
+	int8_t column;
+	uint8_t player;
+	int16_t score;        /* engine score, 0 for unsearched moves */
+	uint8_t depth;        /* search depth, 0 for unsearched moves */
+	uint8_t reserved[3];
+	uint32_t nodes;
+	uint32_t time_us;
+} gl_move;
+
+/* A game being recorded */
+typedef struct gl_record {
+	gl_game game;
+	gl_move* moves;
+	int capacity;
+	struct gl_record* next;
+} gl_record;
+
+/* Appends finished games to a log on a background thread */
+typedef struct gamelog_writer {
+	int fd;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+	gl_record* head;
+	gl_record* tail;
+	int closing;
+} gamelog_writer;
+
+/* Iterates over the games of a memory-mapped log */
+typedef struct gamelog_reader {
+	const unsigned char* data;
+	size_t length;
+	size_t offset;
+} gamelog_reader;
+
+/*
+ * Recording functions
+ */
+gl_record* gamelog_begin(int num_rows, int num_cols, int r);
+void gamelog_move(gl_record* rec, int column, int player, int score, int depth,
+		long nodes, long time_us);
+void gamelog_discard(gl_record* rec);
+
+/*
+ * Writer functions
+ */
+gamelog_writer* gamelog_create(const char* path);
+/* Hand a finished game to the writer, which takes ownership of it */
+void gamelog_submit(gamelog_writer* w, gl_record* rec, int winner);
+/* Write every submitted game and close the log */
+void gamelog_close(gamelog_writer* w);
+
+/*
+ * Reader functions
+ */
+gamelog_reader* gamelog_open(const char* path);
+/* Point game and moves at the next game; 0 at the end of the log */
+int gamelog_next(gamelog_reader* r, const gl_game** game, const gl_move** moves);
+void gamelog_rewind(gamelog_reader* r);
+void gamelog_release(gamelog_reader* r);
+
+#endif /* GAMELOG_H_ */
@@ -3,159 +3,160 @@
 #include "linked_list.h"
 #include "board.h"
 #include "tree.h"
+#include "memory.h"
+
+/* Arena the lists are allocated from, if any */
+static mem_arena* list_arena = NULL;
 
 /**
- * Create, allocate, and return a single-linked list struct
+ * Allocate every list from an arena. Lists are then never freed one by
+ * one; the arena's owner resets it once the whole tree is deleted
+ * @param arena: the arena, or NULL to use malloc
+ */
+void set_list_arena(mem_arena* arena)
+{
+  list_arena = arena;
+}
+
+/**
+ * Create, allocate, and return a list with room for capacity list_nodes
+ * stored contiguously after the list header
+ * @param capacity: the number of list_nodes the list can hold
  * @return allocated list struct
  */
-struct list* create_list()
+struct list* create_list(int capacity)
 {
-  struct list* l = (struct list*) malloc(sizeof(list));
+  struct list* l;
+  if (list_arena != NULL)
+    l = (struct list*) arena_alloc(list_arena, sizeof(list) + sizeof(node) * capacity);
+  else
+    l = (struct list*) malloc(sizeof(list) + sizeof(node) * capacity);
   if (l == NULL) { error("Could not allocate memory for list"); }
-  l -> head = NULL;
-  l -> tail = NULL;
   l -> size = 0;
+  l -> capacity = capacity;
+  l -> refs = 1;
   return l;
 }
 
 /**
- * Deallocate memory for provided list struct and all its list-nodes
+ * Release a reference to the list. The last reference deallocates the list
+ * struct and releases the children of all its list-nodes, unless lists come
+ * from an arena
  * @param list: the list to deallocate
  */
 void delete_list(struct list* list)
 {
-	struct list_node* current = (struct list_node*) list -> head;
-	while (current != NULL) {
-		struct list_node* ptr = (struct list_node*) current -> next;
-		delete_node(current);
-		current = ptr;
-	}
-	free(list);
+  if (list == NULL || --list -> refs > 0 || list_arena != NULL)
+    return;
+  int i;
+  for (i = 0; i < list -> size; i++) {
+    delete_list(list -> head[i].children);
+  }
+  free(list);
 }
 
 /**
- * Create, allocate, and return a list_node struct
- * @param x: the value to give the list_node
+ * Create, allocate, and return a standalone list_node struct, such as a
+ * tree root. Nodes inside a list are created with push().
+ * @param b: the board to copy into the list_node
  * @return allocated list_node struct
  */
 node* create_node(struct board* b)
 {
   node* n = (node*) malloc(sizeof(node));
   if (n == NULL) { error("Could not allocate memory for list"); }
-  n -> value = b;
-  n -> next = NULL;
-  n -> children = create_list();
+  n -> value = *b;
+  n -> children = NULL;
   return n;
 }
 
 /**
- * Deallocate memory for provided list_node struct
+ * Deallocate memory for a list_node created with create_node()
  * @param n: the list_node to deallocate
  */
 void delete_node(node* n)
 {
-	struct list* children = (struct list*) n -> children;
-	delete_list(children);
-	delete_board(n->value);
-	free(n);
+  delete_list(n -> children);
+  free(n);
 }
 
 /**
- * Append a list_node to the end of the list
+ * Append a copy of the board to the end of the list
  * @param list: the list to add the list_node to
- * @param to_add: the list_node to be appended
+ * @param b: the board to be copied into the new list_node
+ * @return: the new list_node
  */
-void push(struct list** list, node** to_add)
+node* push(struct list* list, struct board* b)
 {
-  if (*list == NULL) {
+  if (list == NULL) {
   	printf("Error pushing -- null list\n");
   	exit(1);
-  } else if (*to_add == NULL) {
-  	printf("Error pushing -- null node\n");
+  } else if (list -> size == list -> capacity) {
+  	printf("Error pushing -- full list\n");
   	exit(1);
   }
 
-  int size = get_size(*list);
-  if (size == 0) {
-    (*list) -> head = *to_add;
-    (*list) -> tail = *to_add;
-    (*list) -> size = 1;
-  } else {
-    node* temp = (*list) -> tail;
-    temp -> next = (struct node*) *to_add;
-    (*list) -> tail = *to_add;
-    (*list) -> size = size + 1;
-  }  
-}
-
-/**
- * Remove, deallocate, and return the element stored in the list_node
- * @param list: the list to be popped from
- * @return: the value stored in the head element of the list
- */
-struct list_node* pop(struct list* list)
-{
-  if (list == NULL) { exit(1); }
-  int size = get_size(list);
-  node* result;
-  if (size == 0) {
-    printf("Error removing from list\n");
-  	exit(0);
-  } else if (size == 1) {
-    result = list -> head;
-    list -> head = NULL;
-    list -> tail = NULL;
-    list -> size = 0;
-  } else {
-    result = list -> head;
-    list -> head = (node*) result -> next;
-    list -> size = size - 1;
-  }
-  return result;
+  node* n = &list -> head[list -> size++];
+  n -> value = *b;
+  n -> children = NULL;
+  return n;
 }
 
 /**
  * Peek operation to get the first list_node in the list
  * @param list: the list for the operation to be performed on
- * @return: the list_node stored in the head of the list
+ * @return: the first list_node, or NULL when the list is empty
  */
 node* get(struct list* list)
 {
-  if (list == NULL) { exit(1); }
-  node* result;
-  int size = get_size(list);
-  if (size == 0) {
-    result = NULL;
-  } else {
-    result = list -> head;
-  }
-  return result;
+  if (get_size(list) == 0)
+    return NULL;
+  return &list -> head[0];
 }
 
 /**
  * Returns the number of list_nodes in the list
- * @param list: the list for the operation to be performed on
+ * @param list: the list for the operation to be performed on, may be NULL
  * @return: the size (integer) of the list
  */
 int get_size(struct list* list)
 {
-	/*if (list == NULL) {
-		printf("Cannot return size of null list\n");
-		exit(1);
-	}*/
+  if (list == NULL)
+    return 0;
   return list -> size;
 }
 
 /**
- * Prints the elements stored in the list_nodes, from head to tail
+ * Reorders the list by the best_score of each list_node's board with a
+ * stable insertion sort, so equal scores keep their previous order
+ * @param list: the list to be sorted
+ * @param descending: 1 to put the highest score first, 0 for the lowest
+ */
+void sort_list(struct list* list, int descending)
+{
+  int i, j;
+  for (i = 1; i < get_size(list); i++) {
+    node current = list -> head[i];
+    int score = current.value.best_score;
+    for (j = i; j > 0; j--) {
+      int other = list -> head[j-1].value.best_score;
+      if (descending ? (other >= score) : (other <= score))
+        break;
+      list -> head[j] = list -> head[j-1];
+    }
+    list -> head[j] = current;
+  }
+}
+
+/**
+ * Prints the elements stored in the list_nodes, from first to last
  * @param list: the list for the operation to be performed on
  */
 void print_list(struct list* list)
 {
-  node* ptr = get(list);
-  while (ptr != NULL) {
-    print_node(ptr);
-    ptr = (node*) ptr -> next;
+  int i;
+  for (i = 0; i < get_size(list); i++) {
+    print_node(&list -> head[i]);
   }
 }
 
@@ -165,15 +166,13 @@ void print_list(struct list* list)
  */
 void print_node(node* node)
 {
-  //printf("%d\n", node->value);
-	board* board = (struct board*) node -> value;
-	print_board(board);
+	print_board(&node -> value);
 }
 
 /**
  * Returns a list of child nodes stored in a list_node's children list
  * @param parent: the node from which to retrieve the children list
- * @return: a list of list_nodes
+ * @return: a list of list_nodes, or NULL for a leaf
  */
 struct list* get_children(node** parent)
 {
@@ -182,29 +181,41 @@ struct list* get_children(node** parent)
 }
 
 /**
- * Appends the child list_node to the parent list_node's children list
+ * Appends a copy of the board as a child of the parent list_node. The
+ * parent's children block is allocated on the first call.
  * @param parent: the parent to append the child to
- * @param child: the list_node to be appended
+ * @param b: the board to be copied into the child
+ * @param capacity: the number of children to make room for
+ * @return: the new child list_node
  */
+node* add_child(node** parent, struct board* b, int capacity)
+{
+  if ((*parent) -> children == NULL)
+    (*parent) -> children = create_list(capacity);
+  return push((*parent) -> children, b);
+}
 
-void add_child(node** parent, node** child)
+/**
+ * Point a childless node at another node's children, which it then shares
+ * @param n: the node without children
+ * @param children: the list to share
+ */
+void share_children(node* n, struct list* children)
 {
-  struct list* list = (*parent) -> children;
-  push(&list, child);
+  children -> refs++;
+  n -> children = children;
 }
 
 /**
- * Print the children of the parent node, from head to tail
+ * Print the children of the parent node, from first to last
  * @param parent: the parent list_node to print the children for
  */
 void print_children(node** parent)
 {
-  struct list* child_list = (struct list*) (*parent) -> children;
-  node* ptr = (node*) child_list -> head;
-  while (ptr != NULL) {
+  struct list* child_list = (*parent) -> children;
+  int i;
+  for (i = 0; i < get_size(child_list); i++) {
     printf("Child ");
-    print_node(ptr);
-    ptr = (node*) ptr -> next;
+    print_node(&child_list -> head[i]);
   }
 }
-
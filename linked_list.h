@@ -8,45 +8,55 @@
 #define LINKED_LIST_H_
 #include "board.h"
 #include "tree.h"
+#include "memory.h"
 
 struct list_node;
-struct linked_list;
+struct list;
 
+/*
+ * A node holds its board inline. Its children are stored side by side in a
+ * single block, so walking them is a sequential scan rather than a pointer
+ * chase. Leaves have no block. A block may be shared by every node holding
+ * the same position, which makes the tree a DAG; it counts the nodes
+ * pointing at it and is freed with the last.
+ */
 typedef struct list_node {
-  struct board* value;
-  struct node* next;
+  struct board value;
   struct list* children;
 } node;
 
 typedef struct list {
-  node* head;
-  node* tail;
   int size;
+  int capacity;
+  int refs;
+  node head[];
 } list;
 
 /*
  * Initialization functions
  */
-struct list* create_list();
+struct list* create_list(int capacity);
 void delete_list(struct list* list);
 node* create_node(struct board* b);
 void delete_node(node* node);
+void set_list_arena(mem_arena* arena);
 void error(char* msg);
 
 /*
- * Linked list functions
+ * List functions
  */
-void push(struct list** list, node** node);
-struct list_node* pop(struct list* list);
+node* push(struct list* list, struct board* b);
 node* get(struct list* list);
 int get_size(struct list* list);
+void sort_list(struct list* list, int descending);
 void print_list(struct list* list);
 void print_node(node* node);
 
 /*
  * Tree functions
  */
-void add_child(node** parent, node** child);
+node* add_child(node** parent, struct board* b, int capacity);
 struct list* get_children(node** parent);
+void share_children(node* n, struct list* children);
 void print_children(node** node);
 #endif /* LINKED_LIST_H_ */
@@ -0,0 +1,51 @@
+/*
+ * logdump.c
+ *
+ * Converts a binary game log to text: one line per game with its board
+ * size, winner and move sequence, or with -v one line per move as well.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gamelog.h"
+
+void error(char* msg);
+
+int main(int argc, char* argv[])
+{
+	int verbose = (argc == 3 && strcmp(argv[1], "-v") == 0);
+	if (argc != 2 && !verbose) { error("usage -- ./logdump [-v] file"); }
+
+	gamelog_reader* r = gamelog_open(argv[argc - 1]);
+	if (r == NULL) { error("Could not open game log"); }
+
+	const gl_game* game;
+	const gl_move* moves;
+	long count = 0;
+	while (gamelog_next(r, &game, &moves)) {
+		int i;
+		printf("game %ld: %dx%d r=%d winner %d moves", count++, game->row_len,
+				game->column_len, game->r, game->winner);
+		for (i = 0; i < game->num_moves; i++) {
+			printf(" %d", moves[i].column);
+		}
+		printf("\n");
+
+		if (verbose) {
+			for (i = 0; i < game->num_moves; i++) {
+				const gl_move* m = &moves[i];
+				printf("  %2d player %d column %d score %d depth %d nodes %u time %uus\n",
+						i, m->player, m->column, m->score, m->depth, m->nodes, m->time_us);
+			}
+		}
+	}
+
+	gamelog_release(r);
+	return 0;
+}
+
+void error(char* msg)
+{
+	printf("%s\n", msg);
+	exit(1);
+}
@@ -1,56 +1,504 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 #include <time.h>
+#include <getopt.h>
 #include "board.h"
+#include "bitboard.h"
 #include "linked_list.h"
 #include "tree.h"
+#include "tablebase.h"
+#include "gamelog.h"
+#include "ttable.h"
+#include "eval.h"
+#include "mcts.h"
+#include "trace.h"
+#include "distrib.h"
+#include "perf.h"
+#include "memory.h"
+#include "treedump.h"
+#include "rcache.h"
+#include "dfpn.h"
+#include "nnue.h"
 
-int play(board* starting_board, int r, tree* game_tree);
+#define USAGE "usage -- ./main [--engine minimax|mcts] [--time ms] [--depth plies] [--no-reductions] [--no-extensions]" \
+	" [--playouts count] [--threads count]" \
+	" [--exploration c] [--guided] [--tablebase file] [--cache file] [--eval heuristic|bitboard|nn]" \
+	" [--network file] [--multipv k] [--dag] [--trace file] [--perf-counters] [--huge-pages off|transparent|explicit]" \
+	" [--numa] [--dump-tree file] [--result-cache entries] [--log file] [--games count] n m r\n" \
+	"         ./main --solve [--split ply] [--listen address] [--book file]" \
+	" [--checkpoint file] [--checkpoint-interval seconds] [--resume] n m r\n" \
+	"         ./main --solve --engine dfpn n m r\n" \
+	"         ./main --worker address n m r"
+
+#define ENGINE_MINIMAX 0
+#define ENGINE_MCTS 1
+#define ENGINE_DFPN 2
+
+static struct option long_options[] = {
+	{ "tablebase", required_argument, NULL, 't' },
+	{ "cache", required_argument, NULL, 'c' },
+	{ "eval", required_argument, NULL, 'e' },
+	{ "log", required_argument, NULL, 'l' },
+	{ "games", required_argument, NULL, 'g' },
+	{ "engine", required_argument, NULL, 'E' },
+	{ "time", required_argument, NULL, 'T' },
+	{ "playouts", required_argument, NULL, 'P' },
+	{ "threads", required_argument, NULL, 'j' },
+	{ "exploration", required_argument, NULL, 'x' },
+	{ "guided", no_argument, NULL, 'G' },
+	{ "multipv", required_argument, NULL, 'k' },
+	{ "trace", required_argument, NULL, 'R' },
+	{ "dag", no_argument, NULL, 'D' },
+	{ "solve", no_argument, NULL, 'S' },
+	{ "split", required_argument, NULL, 's' },
+	{ "listen", required_argument, NULL, 'L' },
+	{ "worker", required_argument, NULL, 'W' },
+	{ "book", required_argument, NULL, 'B' },
+	{ "checkpoint", required_argument, NULL, 'C' },
+	{ "checkpoint-interval", required_argument, NULL, 'I' },
+	{ "resume", no_argument, NULL, 'U' },
+	{ "depth", required_argument, NULL, 'd' },
+	{ "no-reductions", no_argument, NULL, 'N' },
+	{ "no-extensions", no_argument, NULL, 'X' },
+	{ "perf-counters", no_argument, NULL, 'p' },
+	{ "huge-pages", required_argument, NULL, 'H' },
+	{ "numa", no_argument, NULL, 'M' },
+	{ "dump-tree", required_argument, NULL, 'O' },
+	{ "result-cache", required_argument, NULL, 'Q' },
+	{ "network", required_argument, NULL, 'w' },
+	{ NULL, 0, NULL, 0 }
+};
+
+/* Engine choosing the moves, and its settings when it is MCTS */
+static int engine = ENGINE_MINIMAX;
+static mcts_options mcts_config;
+/* Root moves the minimax engine scores exactly, 0 for just the best */
+static int multipv = 0;
+/* Game tree nodes, released all at once after every move */
+static mem_arena tree_arena;
+/* File each searched minimax tree is written to, "%d" standing for the move */
+static char* dump_path = NULL;
+/* Minimax decisions kept for positions seen again, if any */
+static result_cache* results = NULL;
+
+int play(board* starting_board, int r, tree* game_tree, gl_record* rec);
+int solve_game(int num_rows, int num_cols, int r, int ply, char* listen_address, char* book_path);
+int prove_game(int num_rows, int num_cols, int r);
 void error(char* msg);
 
 int main(int argc, char* argv[])
 {
+	/* Options */
+	char* tablebase_path = NULL;
+	char* cache_path = NULL;
+	char* log_path = NULL;
+	char* network_path = NULL;
+	int eval = EVAL_HEURISTIC;
+	int num_games = 1;
+	int solve = 0;
+	int split_ply = SPLIT_DEFAULT_PLY;
+	char* listen_address = NULL;
+	char* worker_address = NULL;
+	char* book_path = NULL;
+	char* checkpoint_path = NULL;
+	int checkpoint_interval = CHECKPOINT_DEFAULT_INTERVAL;
+	int resume = 0;
+	long search_time = 0;
+	int depth;
+	int perf = 0;
+	int pages = MEM_PAGES_TRANSPARENT;
+	int numa = 0;
+	int result_entries = 0;
+	int opt;
+	mcts_default_options(&mcts_config);
+	while ((opt = getopt_long(argc, argv, "t:c:e:l:g:E:T:P:j:x:Gk:R:DSs:L:W:B:C:I:Ud:NXpH:MO:Q:w:", long_options, NULL)) != -1) {
+		switch (opt) {
+		case 't':
+			tablebase_path = optarg;
+			break;
+		case 'c':
+			cache_path = optarg;
+			break;
+		case 'e':
+			if (strcmp(optarg, "heuristic") == 0)
+				eval = EVAL_HEURISTIC;
+			else if (strcmp(optarg, "bitboard") == 0)
+				eval = EVAL_BITBOARD;
+			else if (strcmp(optarg, "nn") == 0)
+				eval = EVAL_NN;
+			else
+				error(USAGE);
+			break;
+		case 'l':
+			log_path = optarg;
+			break;
+		case 'g':
+			num_games = strtol(optarg, NULL, 10);
+			if (num_games < 1) { error(USAGE); }
+			break;
+		case 'E':
+			if (strcmp(optarg, "minimax") == 0)
+				engine = ENGINE_MINIMAX;
+			else if (strcmp(optarg, "mcts") == 0)
+				engine = ENGINE_MCTS;
+			else if (strcmp(optarg, "dfpn") == 0)
+				engine = ENGINE_DFPN;
+			else
+				error(USAGE);
+			break;
+		case 'T':
+			search_time = strtol(optarg, NULL, 10);
+			mcts_config.max_time_ms = search_time;
+			break;
+		case 'P':
+			mcts_config.max_playouts = strtol(optarg, NULL, 10);
+			// A playout limit alone replaces the default time limit
+			mcts_config.max_time_ms = 0;
+			break;
+		case 'j':
+			mcts_config.threads = strtol(optarg, NULL, 10);
+			break;
+		case 'x':
+			mcts_config.exploration = strtod(optarg, NULL);
+			break;
+		case 'G':
+			mcts_config.guided = 1;
+			break;
+		case 'D':
+			set_transpositions(1);
+			break;
+		case 'R':
+			if (trace_open(optarg) != 0) { error("Could not open trace file"); }
+			break;
+		case 'k':
+			multipv = strtol(optarg, NULL, 10);
+			if (multipv < 1) { error(USAGE); }
+			break;
+		case 'S':
+			solve = 1;
+			break;
+		case 's':
+			split_ply = strtol(optarg, NULL, 10);
+			if (split_ply < 0) { error(USAGE); }
+			break;
+		case 'L':
+			listen_address = optarg;
+			break;
+		case 'W':
+			worker_address = optarg;
+			break;
+		case 'B':
+			book_path = optarg;
+			break;
+		case 'C':
+			checkpoint_path = optarg;
+			break;
+		case 'I':
+			checkpoint_interval = strtol(optarg, NULL, 10);
+			if (checkpoint_interval < 1) { error(USAGE); }
+			break;
+		case 'U':
+			resume = 1;
+			break;
+		case 'd':
+			depth = strtol(optarg, NULL, 10);
+			if (depth < 1 || depth + FORCED_EXTENSIONS >= TASK_STACK) { error(USAGE); }
+			set_search_depth(depth);
+			break;
+		case 'N':
+			set_reductions(0);
+			break;
+		case 'X':
+			set_extensions(0);
+			break;
+		case 'p':
+			perf = 1;
+			break;
+		case 'H':
+			if (strcmp(optarg, "off") == 0)
+				pages = MEM_PAGES_SMALL;
+			else if (strcmp(optarg, "transparent") == 0)
+				pages = MEM_PAGES_TRANSPARENT;
+			else if (strcmp(optarg, "explicit") == 0)
+				pages = MEM_PAGES_EXPLICIT;
+			else
+				error(USAGE);
+			break;
+		case 'M':
+			numa = 1;
+			break;
+		case 'O':
+			dump_path = optarg;
+			break;
+		case 'Q':
+			result_entries = strtol(optarg, NULL, 10);
+			if (result_entries < 1) { error(USAGE); }
+			break;
+		case 'w':
+			network_path = optarg;
+			break;
+		default:
+			error(USAGE);
+		}
+	}
+
 	/* Error handling for command line arguments */
-	if (argc != 4) { error("usage -- ./main n m r"); }
+	if (argc - optind != 3) { error(USAGE); }
 
 	/* Initialize board */
-	int num_rows = strtol(argv[1], NULL, 10);
-	int num_cols = strtol(argv[2], NULL, 10);
-	int r = strtol(argv[3], NULL, 10);
-	board* b = init_board(num_rows, num_cols, r);
-
-	/* Initialize game tree */
-	tree* game_tree = create_tree();
-	set_root(game_tree, b);
-
-	/* Start game */
-	int win = play(b, r, game_tree);
-
-	/* End game */
-	if (system("clear") > 0){}
-	if (win > 0)
-		printf("Winner: %d\n", win);
-	else
-		printf("Cat's game\n");
-	print_board(game_tree->root->value);
+	int num_rows = strtol(argv[optind], NULL, 10);
+	int num_cols = strtol(argv[optind + 1], NULL, 10);
+	int r = strtol(argv[optind + 2], NULL, 10);
+	if (num_rows < 1 || num_cols < 1 || num_rows * num_cols > BOARD_MAX_CELLS) {
+		error("board too large -- n * m must be at most BOARD_MAX_CELLS");
+	}
+
+	/* Back the big tables and the game tree with large pages */
+	set_memory(pages, numa);
+	arena_init(&tree_arena);
+	set_list_arena(&tree_arena);
+
+	/* Exact solving, alone or spread over workers */
+	if (worker_address != NULL || solve) {
+		if (!bitboard_fits(num_rows, num_cols)) { error("--solve needs a board with (n + 1) * m <= 64"); }
+		if (worker_address != NULL) {
+			if (run_worker(worker_address, num_rows, num_cols, r) != 0) { error("Lost the coordinator"); }
+			return 0;
+		}
+		if (engine == ENGINE_DFPN)
+			return prove_game(num_rows, num_cols, r);
+		if (engine != ENGINE_MINIMAX) { error("--solve runs with --engine minimax or dfpn"); }
+		if (resume && checkpoint_path == NULL) { error("--resume needs --checkpoint file"); }
+		set_checkpoint(checkpoint_path, checkpoint_interval, resume);
+		return solve_game(num_rows, num_cols, r, split_ply, listen_address, book_path);
+	}
+	if (engine == ENGINE_DFPN) { error("--engine dfpn only solves, use it with --solve"); }
+
+	/* Load tablebase */
+	tablebase* tb = NULL;
+	if (tablebase_path != NULL) {
+		tb = tb_open(tablebase_path);
+		if (tb == NULL) { error("Could not open tablebase"); }
+		set_tablebase(tb);
+	}
+
+	/* Time limit per minimax move */
+	set_search_time(search_time);
+
+	/* Select leaf evaluator */
+	if (eval == EVAL_BITBOARD && !bitboard_fits(num_rows, num_cols)) {
+		error("--eval bitboard needs a board with (n + 1) * m <= 64");
+	}
+	nn_network* net = NULL;
+	if (eval == EVAL_NN) {
+		if (!bitboard_fits(num_rows, num_cols)) { error("--eval nn needs a board with (n + 1) * m <= 64"); }
+		if (network_path == NULL) { error("--eval nn needs a --network file"); }
+		net = nn_load(network_path, num_rows, num_cols, r, WIN_SCORE);
+		if (net == NULL) { error("Could not open network -- it may belong to another board size"); }
+		set_network(net);
+	}
+	set_evaluator(eval, num_rows, num_cols, r);
+
+	/* Open transposition cache */
+	ttable* tt = NULL;
+	if (cache_path != NULL) {
+		tt = tt_open(cache_path, num_rows, num_cols, r, get_search_settings(), TT_DEFAULT_BITS);
+		if (tt == NULL) { error("Could not open cache -- it may belong to another board size or other search settings"); }
+		set_cache(tt);
+	}
+
+	/* Decisions for repeated positions */
+	if (result_entries > 0)
+		results = rc_create(result_entries);
+
+	/* Hardware counters */
+	if (perf)
+		printf("perf: %d of %d hardware counters available\n", perf_open(), PERF_EVENTS);
+
+	/* Open game log */
+	gamelog_writer* log = NULL;
+	if (log_path != NULL) {
+		log = gamelog_create(log_path);
+		if (log == NULL) { error("Could not open game log"); }
+	}
+
+	srand(time(NULL));
+	int game;
+	for (game = 0; game < num_games; game++) {
+		/* Initialize game tree */
+		board* b = init_board(num_rows, num_cols, r);
+		tree* game_tree = create_tree();
+		set_root(game_tree, b);
+		delete_board(b);
+		b = &game_tree->root->value;
+
+		/* Start game */
+		gl_record* rec = (log != NULL) ? gamelog_begin(num_rows, num_cols, r) : NULL;
+		int win = play(b, r, game_tree, rec);
+		if (rec != NULL)
+			gamelog_submit(log, rec, (win > 0) ? win : 0);
+
+		/* End game */
+		if (num_games == 1 && system("clear") > 0){}
+		if (win > 0)
+			printf("Winner: %d\n", win);
+		else
+			printf("Cat's game\n");
+		print_board(&game_tree->root->value);
+
+		delete_tree(game_tree);
+	}
 
 	/* Cleanup */
-	delete_tree(game_tree);
+	if (results != NULL) {
+		printf("Result cache: %ld hits, %ld misses, %ld invalidations\n", results->hits, results->misses,
+				results->invalidations);
+		rc_delete(results);
+	}
+	if (perf)
+		perf_close();
+	gamelog_close(log);
+	trace_close();
+	tt_close(tt);
+	tb_close(tb);
+	nn_delete(net);
+	arena_release(&tree_arena);
 	return 0;
 }
 
-int play(board* b, int r, tree* game_tree)
+/**
+ * Returns the time elapsed since start, in microseconds.
+ */
+static long elapsed_us(struct timespec* start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000000L + (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+/**
+ * Writes the searched tree below the root to the dump file, replacing a
+ * "%d" in its name with the move number.
+ */
+static void dump_tree(struct list_node* root, int player, int turn)
+{
+	char path[4096];
+	char* mark = strstr(dump_path, "%d");
+	if (mark != NULL)
+		snprintf(path, sizeof(path), "%.*s%d%s", (int) (mark - dump_path), dump_path, turn, mark + 2);
+	else
+		snprintf(path, sizeof(path), "%s", dump_path);
+	if (td_write(path, root, player) != 0) { error("Could not write tree dump"); }
+}
+
+/**
+ * Searches the root with multi-PV and prints a line per root move.
+ */
+static void analyze(struct list_node** root, int maximizing)
+{
+	search_line lines[BOARD_MAX_CELLS];
+	int n = multipv_decision(root, maximizing, multipv, lines);
+	int i, j;
+	for (i = 0; i < n; i++) {
+		printf("  column %d score %d%s pv", lines[i].move, lines[i].score, lines[i].exact ? "" : " (bound)");
+		for (j = 0; j < lines[i].length; j++) {
+			printf(" %d", lines[i].pv[j]);
+		}
+		printf("\n");
+	}
+}
+
+/**
+ * Solves the empty board exactly. The tree is split at the given ply and
+ * the positions there are solved in this process, or by workers when a
+ * listen address is given; their values are merged back to the root.
+ * Returns 1 when interrupted, after the checkpoint has been written.
+ */
+int solve_game(int num_rows, int num_cols, int r, int ply, char* listen_address, char* book_path)
+{
+	const char* names[4] = { "unknown", "loss", "draw", "win" };
+	split* s = create_split(num_rows, num_cols, r, ply);
+	printf("Split at ply %d: %llu work units\n", s->ply, (unsigned long long) s->num_units);
+	fflush(stdout);
+
+	int status = (listen_address != NULL) ? run_coordinator(s, listen_address) : solve_units(s);
+	if (status == 1) { error("Could not listen on address"); }
+	if (status == 2) {
+		printf("Interrupted with %llu of %llu units solved; continue with --resume\n",
+				(unsigned long long) s->num_done, (unsigned long long) s->num_units);
+		delete_split(s);
+		return 1;
+	}
+
+	long nodes = 0;
+	uint64_t i;
+	for (i = 0; i < s->num_units; i++) {
+		nodes += s->units[i].nodes;
+	}
+	int value = merge_split(s);
+	printf("Empty board is a %s for the first player (%ld nodes)\n", names[value], nodes);
+
+	if (book_path != NULL && write_book(s, book_path) != 0) { error("Could not write book"); }
+	delete_split(s);
+	return 0;
+}
+
+/**
+ * Solves the empty board with proof-number search: a first-player win is
+ * proved or disproved, then, if disproved, a second-player win. Neither
+ * means a draw.
+ */
+int prove_game(int num_rows, int num_cols, int r)
+{
+	const char* names[4] = { "unknown", "loss", "draw", "win" };
+	const char* players[3] = { "", "first", "second" };
+	dfpn* d = create_dfpn(num_rows, num_cols, r, DFPN_TABLE_BITS);
+	bitboard bb;
+	int attacker, value = TB_DRAW;
+
+	memset(&bb, 0, sizeof(bb));
+	bb.row_len = num_rows;
+	bb.column_len = num_cols;
+	bb.r = r;
+	d->progress = 1;
+	for (attacker = 1; attacker <= 2; attacker++) {
+		long start = d->nodes;
+		printf("Proving a %s-player win\n", players[attacker]);
+		fflush(stdout);
+		int proven = dfpn_prove(d, &bb, attacker);
+		long used = dfpn_used(d);
+		printf("  %s in %ld nodes, %zu MB table with %ld of %ld entries in use\n",
+				proven ? "proven" : "disproven", d->nodes - start, dfpn_memory(d) >> 20,
+				used, 1L << d->table_bits);
+		if (proven) {
+			value = (attacker == 1) ? TB_WIN : TB_LOSS;
+			break;
+		}
+	}
+	printf("Empty board is a %s for the first player (%ld nodes)\n", names[value], d->nodes);
+	delete_dfpn(d);
+	return 0;
+}
+
+int play(board* b, int r, tree* game_tree, gl_record* rec)
 {
 	// Sentinel variable
 	int win = 0;
 	// Current player
 	int player = 1;
+	// Moves played so far
+	int turn = 2;
 
 	// Randomize first and second moves
-	srand(time(NULL));
-	add_checker(game_tree->root->value, (rand() % 7), 1);
-	add_checker(game_tree->root->value, (rand() % 7), 2);
+	int opening[2] = { rand() % b->column_len, rand() % b->column_len };
+	add_checker(&game_tree->root->value, opening[0], 1);
+	add_checker(&game_tree->root->value, opening[1], 2);
+	if (rec != NULL) {
+		gamelog_move(rec, opening[0], 1, 0, 0, 0, 0);
+		gamelog_move(rec, opening[1], 2, 0, 0, 0, 0);
+	}
 
 	// Loop until win condition is met
 	while (win == 0) {
@@ -62,36 +510,107 @@ int play(board* b, int r, tree* game_tree)
 
 		// Store player input, best-scoring move, and best column
 		int input, best, best_column;
+		int depth;
+		long nodes;
+		// Decision found in the result cache
+		rc_result cached;
+		int hit = 0;
+		struct timespec start;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		uint64_t move_span = trace_begin();
+
+		if (engine == ENGINE_MCTS) {
+			mcts_result result;
+			perf_begin(PERF_SEARCH);
+			mcts_decide(b, player, &mcts_config, &result);
+			perf_end(PERF_SEARCH);
+			best = result.score;
+			best_column = result.move;
+			nodes = result.playouts;
+			depth = result.depth;
+			printf("Best move for player %d: Score %d Column %d Playouts %ld\n", player, best, best_column, nodes);
+
+		// Position decided before with the same settings
+		} else if (results != NULL && multipv == 0 && rc_lookup(results, b, player, &cached)) {
+			hit = 1;
+			best = cached.score;
+			best_column = cached.move;
+			nodes = 0;
+			depth = cached.depth;
+			printf("Best move for player %d: Score %d Column %d Nodes %ld Depth %d (cached)\n", player, best,
+					best_column, nodes, depth);
 
 		// Player 1 is AI
-		if (player == 1) {
+		} else if (player == 1) {
 			/*printf("Input move: ");
 			if (scanf("%d", &input)){}
 			best_column = input;*/
 
-			generate_permutations(&game_tree->root, game_tree->root->value, 0, 0);
-			root -> value -> best_score = -999;
-			max_decision(&root);
-			best = root -> value -> best_score;
-			best_column = root -> value -> move;
-			printf("Best move for player %d: Score %d Column %d\n", player, best, best_column);
+			uint64_t generate = trace_begin();
+			perf_begin(PERF_GENERATE);
+			generate_permutations(&game_tree->root, &game_tree->root->value, 0, 0);
+			perf_end(PERF_GENERATE);
+			trace_end("generate", "tree", generate);
+			root -> value.best_score = -999;
+			reset_search_nodes();
+			perf_begin(PERF_SEARCH);
+			if (multipv > 0)
+				analyze(&root, 1);
+			else
+				max_decision(&root);
+			perf_end(PERF_SEARCH);
+			best = root -> value.best_score;
+			best_column = root -> value.move;
+			nodes = get_search_nodes();
+			depth = get_search_depth();
+			printf("Best move for player %d: Score %d Column %d Nodes %ld Depth %d\n", player, best, best_column,
+					nodes, depth);
 
 		} else {
 			/*printf("Input move: ");
 			if (scanf("%d", &input)){}
 			best_column = input;
 			*/
-			generate_permutations(&game_tree->root, game_tree->root->value, 0, 1);
-			root -> value -> best_score = 999;
-			min_decision(&root);
-			best = root -> value -> best_score;
-			best_column = root -> value -> move;
-			printf("Best move for player %d: Score %d Column %d\n", player, best, best_column);
+			uint64_t generate = trace_begin();
+			perf_begin(PERF_GENERATE);
+			generate_permutations(&game_tree->root, &game_tree->root->value, 0, 1);
+			perf_end(PERF_GENERATE);
+			trace_end("generate", "tree", generate);
+			root -> value.best_score = 999;
+			reset_search_nodes();
+			perf_begin(PERF_SEARCH);
+			if (multipv > 0)
+				analyze(&root, 0);
+			else
+				min_decision(&root);
+			perf_end(PERF_SEARCH);
+			best = root -> value.best_score;
+			best_column = root -> value.move;
+			nodes = get_search_nodes();
+			depth = get_search_depth();
+			printf("Best move for player %d: Score %d Column %d Nodes %ld Depth %d\n", player, best, best_column,
+					nodes, depth);
+
+		}
 
+		trace_end_arg("move", "game", move_span, "player", player);
+		long time_us = elapsed_us(&start);
+		if (perf_enabled) {
+			perf_report("perf", nodes);
+			perf_reset();
+		}
+		if (dump_path != NULL && engine == ENGINE_MINIMAX && !hit)
+			dump_tree(root, player, turn);
+		if (results != NULL && engine == ENGINE_MINIMAX && multipv == 0 && !hit) {
+			cached.move = best_column;
+			cached.score = best;
+			cached.depth = depth;
+			cached.pv_length = get_search_pv(cached.pv);
+			rc_store(results, b, player, &cached);
 		}
 
 		// Verify that the move was valid and that the column could be added to
-		if (add_checker(root->value, best_column, player) == 1) {
+		if (add_checker(&root->value, best_column, player) == 1) {
 			if (terminal_test(b) != -1) {
 				printf("Invalid move for player %d. Retry last turn\n", player);
 				continue;
@@ -99,11 +618,15 @@ int play(board* b, int r, tree* game_tree)
 				win = terminal_test(b);
 			}
 		} else {
+			if (rec != NULL)
+				gamelog_move(rec, best_column, player, best, depth, nodes, time_us);
 			swap(&player);
+			turn++;
 		}
 
 		// Delete the game board
 		delete_permutations(&game_tree, &b);
+		arena_reset(&tree_arena);
 		//if (system("clear")){}
 
 		// Check win condition
@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <omp.h>
+#include "board.h"
+#include "bitboard.h"
+#include "threat.h"
+#include "tree.h"
+#include "trace.h"
+#include "memory.h"
+#include "mcts.h"
+
+/**
+ * Fills in the default options: a one second search on every thread.
+ * @param o: the options
+ */
+void mcts_default_options(mcts_options* o)
+{
+	o->exploration = 1.4;
+	o->max_playouts = 0;
+	o->max_time_ms = 1000;
+	o->threads = 0;
+	o->guided = 0;
+}
+
+/**
+ * xorshift64* generator, one per thread.
+ */
+static uint64_t next_random(uint64_t* seed)
+{
+	*seed ^= *seed >> 12;
+	*seed ^= *seed << 25;
+	*seed ^= *seed >> 27;
+	return *seed * 0x2545f4914f6cdd1dULL;
+}
+
+/**
+ * Returns the number of checkers of player in a line through (row, col)
+ * in direction (dr, dc), counting the cell itself once.
+ */
+static int line_length(board* b, int row, int col, int dr, int dc, int player)
+{
+	int length = 1, sign;
+	for (sign = -1; sign <= 1; sign += 2) {
+		int i = row + sign * dr, j = col + sign * dc;
+		while (i >= 0 && i < b->row_len && j >= 0 && j < b->column_len &&
+				get_cell(b, get_index(b->column_len, i, j)) == player) {
+			length++;
+			i += sign * dr;
+			j += sign * dc;
+		}
+	}
+	return length;
+}
+
+/**
+ * Returns 1 when column can be played.
+ */
+static int state_legal(mcts_state* s, int column)
+{
+	if (s->fits)
+		return (playable_cells(s->bb.mask, s->bb.row_len, s->bb.column_len) &
+				column_mask(s->bb.row_len, column)) != 0;
+	return get_cell(&s->b, column) == 0;
+}
+
+/**
+ * Plays column for the player to move.
+ * @return 1 when the move completes r in a row
+ */
+static int state_play(mcts_state* s, int column)
+{
+	int player = s->player;
+	int won;
+
+	if (s->fits) {
+		bitboard* bb = &s->bb;
+		uint64_t cell = playable_cells(bb->mask, bb->row_len, bb->column_len) &
+				column_mask(bb->row_len, column);
+		uint64_t stones = (player == 1) ? bb->p1 : bb->p1 ^ bb->mask;
+		won = (winning_cells(stones, bb->mask, bb->row_len, bb->column_len, bb->r) & cell) != 0;
+		if (player == 1)
+			bb->p1 |= cell;
+		bb->mask |= cell;
+		bb->moves++;
+	} else {
+		board* b = &s->b;
+		int row = b->row_len - 1;
+		while (get_cell(b, get_index(b->column_len, row, column)) != 0)
+			row--;
+		set_cell(b, get_index(b->column_len, row, column), player);
+		won = line_length(b, row, column, 0, 1, player) >= b->r ||
+				line_length(b, row, column, 1, 0, player) >= b->r ||
+				line_length(b, row, column, 1, 1, player) >= b->r ||
+				line_length(b, row, column, 1, -1, player) >= b->r;
+	}
+	s->player = (player == 1) ? 2 : 1;
+	s->moves++;
+	return won;
+}
+
+/**
+ * Returns 1 when the board is full.
+ */
+static int state_full(mcts_state* s)
+{
+	return s->moves == s->b.row_len * s->b.column_len;
+}
+
+/**
+ * Picks the move of a playout. Guided playouts take a winning move, then
+ * block an opponent's winning move, before falling back to a random one.
+ */
+static int playout_move(mcts_state* s, int guided, uint64_t* seed)
+{
+	int columns[BOARD_MAX_CELLS];
+	int n = 0, i;
+	int num_cols = s->b.column_len;
+
+	if (guided && s->fits) {
+		bitboard* bb = &s->bb;
+		uint64_t playable = playable_cells(bb->mask, bb->row_len, bb->column_len);
+		uint64_t own = (s->player == 1) ? bb->p1 : bb->p1 ^ bb->mask;
+		uint64_t cells = winning_cells(own, bb->mask, bb->row_len, bb->column_len, bb->r) & playable;
+		if (cells == 0)
+			cells = winning_cells(own ^ bb->mask, bb->mask, bb->row_len, bb->column_len, bb->r) & playable;
+		if (cells != 0)
+			return __builtin_ctz(cell_columns(cells & -cells, bb->row_len, bb->column_len));
+	}
+
+	for (i = 0; i < num_cols; i++) {
+		if (state_legal(s, i))
+			columns[n++] = i;
+	}
+	return columns[next_random(seed) % n];
+}
+
+/**
+ * Plays random moves until the game ends.
+ * @return the winner, or 0 for a draw
+ */
+static int playout(mcts_state* s, int guided, uint64_t* seed)
+{
+	while (!state_full(s)) {
+		int player = s->player;
+		if (state_play(s, playout_move(s, guided, seed)))
+			return player;
+	}
+	return 0;
+}
+
+/* Node storage, one arena per thread so each thread's nodes stay on its
+ * own NUMA node; reset after every search */
+static mem_arena* arenas = NULL;
+static int num_arenas = 0;
+
+/**
+ * Adds a child per legal move of the node's position, noting the children
+ * whose move ends the game. Only the thread that claimed the node expands it.
+ */
+static void expand(mcts_node* n, mcts_state* s, mem_arena* arena)
+{
+	int num_cols = s->b.column_len;
+	mcts_node* children = arena_calloc(arena, num_cols * sizeof(mcts_node));
+	int count = 0, i;
+
+	for (i = 0; i < num_cols; i++) {
+		if (!state_legal(s, i))
+			continue;
+		mcts_state next = *s;
+		mcts_node* child = &children[count++];
+		child->move = i;
+		if (state_play(&next, i))
+			child->terminal = MCTS_WIN;
+		else if (state_full(&next))
+			child->terminal = MCTS_DRAW;
+	}
+
+	n->num_children = count;
+	__atomic_store_n(&n->children, children, __ATOMIC_RELEASE);
+	__atomic_store_n(&n->expanding, 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * Picks the child with the highest upper confidence bound. Children not
+ * yet visited come first.
+ */
+static mcts_node* select_child(mcts_node* n, double exploration)
+{
+	double log_visits = log(__atomic_load_n(&n->visits, __ATOMIC_RELAXED) + 1);
+	mcts_node* best = &n->children[0];
+	double best_value = -1;
+	int i;
+
+	for (i = 0; i < n->num_children; i++) {
+		mcts_node* child = &n->children[i];
+		int visits = __atomic_load_n(&child->visits, __ATOMIC_RELAXED);
+		if (visits == 0)
+			return child;
+		double value = __atomic_load_n(&child->reward, __ATOMIC_RELAXED) / (2.0 * visits) +
+				exploration * sqrt(log_visits / visits);
+		if (value > best_value) {
+			best_value = value;
+			best = child;
+		}
+	}
+	return best;
+}
+
+/**
+ * Runs one playout: selects a path down the tree, expands its last node,
+ * plays the game out, and adds the result along the path.
+ * @return the depth of the path
+ */
+static int simulate(mcts_node* root, mcts_state* root_state, mcts_options* o, uint64_t* seed,
+		mem_arena* arena)
+{
+	mcts_node* path[BOARD_MAX_CELLS + 1];
+	int movers[BOARD_MAX_CELLS + 1];
+	mcts_state s = *root_state;
+	mcts_node* n = root;
+	int depth = 0, winner, i;
+
+	__atomic_add_fetch(&root->visits, 1, __ATOMIC_RELAXED);
+	while (1) {
+		if (n->terminal == MCTS_WIN) {
+			winner = movers[depth - 1];
+			break;
+		} else if (n->terminal == MCTS_DRAW) {
+			winner = 0;
+			break;
+		}
+
+		if (__atomic_load_n(&n->expanding, __ATOMIC_ACQUIRE) != 2) {
+			int expected = 0;
+			if ((n == root || __atomic_load_n(&n->visits, __ATOMIC_RELAXED) >= MCTS_EXPAND) &&
+					__atomic_compare_exchange_n(&n->expanding, &expected, 1, 0,
+							__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+				expand(n, &s, arena);
+			} else {
+				// Not worth expanding yet, or another thread is on it
+				winner = playout(&s, o->guided, seed);
+				break;
+			}
+		}
+
+		n = select_child(n, o->exploration);
+		__atomic_add_fetch(&n->visits, 1, __ATOMIC_RELAXED);
+		movers[depth] = s.player;
+		path[depth++] = n;
+		state_play(&s, n->move);
+	}
+
+	for (i = 0; i < depth; i++) {
+		int reward = (winner == 0) ? 1 : (winner == movers[i]) ? 2 : 0;
+		__atomic_add_fetch(&path[i]->reward, reward, __ATOMIC_RELAXED);
+	}
+	return depth;
+}
+
+/**
+ * Returns the milliseconds elapsed since start.
+ */
+static long elapsed_ms(struct timespec* start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000L + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+/**
+ * Picks a move with Monte Carlo tree search. Every thread runs playouts on
+ * one shared tree until the playout or time limit is reached; the move
+ * played most often from the root is chosen.
+ * @param b: the position, with at least one legal move
+ * @param player: the player to move, 1 or 2
+ * @param o: the search options
+ * @param result: filled with the move, its score and the playouts run
+ */
+void mcts_decide(board* b, int player, mcts_options* o, mcts_result* result)
+{
+	mcts_node root;
+	mcts_state s;
+	struct timespec start;
+	long playouts = 0;
+	int max_depth = 0;
+	int stop = 0;
+	int i;
+
+	memset(&root, 0, sizeof(root));
+	memset(&s, 0, sizeof(s));
+	s.b = *b;
+	s.player = player;
+	s.fits = bitboard_fits(b->row_len, b->column_len);
+	if (s.fits)
+		bitboard_encode(b, &s.bb);
+	for (i = 0; i < b->row_len * b->column_len; i++) {
+		s.moves += (get_cell(b, i) != 0);
+	}
+
+	long limit = o->max_playouts;
+	if (limit == 0 && o->max_time_ms == 0)
+		limit = 100000;
+	uint64_t base_seed = ((uint64_t) rand() << 32) ^ rand();
+	int num_threads = (o->threads > 0) ? o->threads : omp_get_max_threads();
+	if (num_threads > num_arenas) {
+		arenas = realloc(arenas, sizeof(mem_arena) * num_threads);
+		for (i = num_arenas; i < num_threads; i++) {
+			arena_init(&arenas[i]);
+		}
+		num_arenas = num_threads;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	#pragma omp parallel num_threads(num_threads)
+	{
+		uint64_t seed = (base_seed + 1) * (omp_get_thread_num() + 1) * 0x9e3779b97f4a7c15ULL;
+		mem_arena* arena = &arenas[omp_get_thread_num()];
+		uint64_t work = trace_begin();
+		long count = 0;
+		int deepest = 0;
+		while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+			long done = __atomic_add_fetch(&playouts, 1, __ATOMIC_RELAXED);
+			if (limit > 0 && done > limit) {
+				__atomic_sub_fetch(&playouts, 1, __ATOMIC_RELAXED);
+				break;
+			}
+			int depth = simulate(&root, &s, o, &seed, arena);
+			count++;
+			if (depth > deepest)
+				deepest = depth;
+			if (o->max_time_ms > 0 && done % MCTS_CLOCK_INTERVAL == 0 &&
+					elapsed_ms(&start) >= o->max_time_ms)
+				__atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+		}
+		trace_end_arg("playouts", "mcts", work, "count", count);
+
+		// Time spent waiting for the slowest thread
+		uint64_t idle = trace_begin();
+		#pragma omp barrier
+		trace_end("idle", "mcts", idle);
+
+		#pragma omp critical
+		if (deepest > max_depth)
+			max_depth = deepest;
+	}
+
+	mcts_node* best = &root.children[0];
+	for (i = 1; i < root.num_children; i++) {
+		if (root.children[i].visits > best->visits)
+			best = &root.children[i];
+	}
+	// Win rate for the mover, mapped onto the minimax score range
+	double rate = (best->visits > 0) ? best->reward / (2.0 * best->visits) : 0.5;
+	int score = (int) lround((2 * rate - 1) * WIN_SCORE);
+	if (best->terminal == MCTS_WIN)
+		score = WIN_SCORE;
+
+	result->move = best->move;
+	result->score = (player == 1) ? score : -score;
+	result->playouts = playouts;
+	result->depth = max_depth;
+	for (i = 0; i < num_threads; i++) {
+		arena_reset(&arenas[i]);
+	}
+}
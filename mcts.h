@@ -0,0 +1,63 @@
+/*
+ * mcts.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+#ifndef MCTS_H_
+#define MCTS_H_
+#include "board.h"
+#include "bitboard.h"
+
+/* Visits a leaf needs before its children are added */
+#define MCTS_EXPAND 2
+/* Playouts between checks of the clock */
+#define MCTS_CLOCK_INTERVAL 64
+
+typedef struct mcts_options {
+	double exploration;   /* UCT exploration constant */
+	long max_playouts;    /* 0 for no limit */
+	long max_time_ms;     /* 0 for no limit */
+	int threads;          /* 0 for OMP_NUM_THREADS */
+	int guided;           /* playouts take wins and block threats */
+} mcts_options;
+
+/*
+ * A node of the shared tree. Statistics are for the player whose move led
+ * to the node and are updated atomically; a thread selecting a node counts
+ * its visit at once, a virtual loss until its playout's result arrives.
+ */
+typedef struct mcts_node {
+	struct mcts_node* children;
+	int num_children;
+	int visits;
+	int reward;           /* 2 per win, 1 per draw */
+	int expanding;        /* 0, 1 while being expanded, 2 once expanded */
+	signed char move;
+	unsigned char terminal; /* MCTS_WIN or MCTS_DRAW once the game is over */
+} mcts_node;
+
+#define MCTS_OPEN 0
+#define MCTS_WIN 1
+#define MCTS_DRAW 2
+
+/* Position during selection and playouts */
+typedef struct mcts_state {
+	board b;              /* boards that do not fit in a bitboard */
+	bitboard bb;
+	int fits;
+	int player;           /* player to move */
+	int moves;
+} mcts_state;
+
+typedef struct mcts_result {
+	int move;
+	int score;            /* win rate mapped to -WIN_SCORE..WIN_SCORE for player 1 */
+	long playouts;
+	int depth;            /* deepest node selected */
+} mcts_result;
+
+void mcts_default_options(mcts_options* o);
+/* Pick a move for player (1 or 2) on b */
+void mcts_decide(board* b, int player, mcts_options* o, mcts_result* result);
+
+#endif /* MCTS_H_ */
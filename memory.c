@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "memory.h"
+
+void error(char* msg);
+
+/* NUMA memory policies, from <linux/mempolicy.h> */
+#define MPOL_INTERLEAVE 3
+#define MPOL_LOCAL 4
+
+static int memory_pages = MEM_PAGES_TRANSPARENT;
+static int memory_numa = 0;
+/* Online NUMA nodes, bit per node */
+static unsigned long numa_nodes = 0;
+
+/**
+ * Reads the online NUMA nodes, such as "0-1" or "0,2".
+ * @return a mask with a bit per node, 0 if unknown
+ */
+static unsigned long online_nodes()
+{
+	FILE* in = fopen("/sys/devices/system/node/online", "r");
+	unsigned long mask = 0;
+	int first, last;
+	char sep;
+	if (in == NULL)
+		return 0;
+	while (fscanf(in, "%d", &first) == 1) {
+		last = first;
+		if (fscanf(in, "%c", &sep) == 1 && sep == '-') {
+			if (fscanf(in, "%d", &last) != 1)
+				break;
+			if (fscanf(in, "%c", &sep) != 1)
+				sep = '\n';
+		}
+		for (; first <= last && first < (int) (8 * sizeof(mask)); first++) {
+			mask |= 1UL << first;
+		}
+		if (sep != ',')
+			break;
+	}
+	fclose(in);
+	return mask;
+}
+
+/**
+ * Chooses how later allocations are backed.
+ * @param pages: MEM_PAGES_SMALL, MEM_PAGES_TRANSPARENT or MEM_PAGES_EXPLICIT
+ * @param numa: non-zero to interleave shared memory over the NUMA nodes and
+ * keep other memory on the node of the thread that first touches it
+ */
+void set_memory(int pages, int numa)
+{
+	memory_pages = pages;
+	memory_numa = numa;
+	if (numa)
+		numa_nodes = online_nodes();
+}
+
+/**
+ * Maps zero-filled memory. The kernel zeroes each page when it is first
+ * touched, so even very large tables cost nothing until used. Reserved
+ * huge pages are tried first when asked for, then transparent huge pages,
+ * then base pages; any of the NUMA and huge page requests may be refused
+ * without the allocation failing.
+ * @param size: bytes
+ * @param shared: non-zero for memory every thread uses, such as a table
+ * @return the memory; allocation failure is fatal
+ */
+void* mem_alloc(size_t size, int shared)
+{
+	void* p = MAP_FAILED;
+	size_t length = size;
+
+	if (memory_pages != MEM_PAGES_SMALL && size >= MEM_HUGE_PAGE)
+		length = (size + MEM_HUGE_PAGE - 1) & ~(MEM_HUGE_PAGE - 1);
+
+	if (memory_pages == MEM_PAGES_EXPLICIT && size >= MEM_HUGE_PAGE)
+		p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (p == MAP_FAILED) {
+		p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) { error("Could not allocate memory"); }
+#ifdef MADV_HUGEPAGE
+		if (memory_pages != MEM_PAGES_SMALL && size >= MEM_HUGE_PAGE)
+			madvise(p, length, MADV_HUGEPAGE);
+#endif
+	}
+
+	// Policies apply to pages not yet touched, which is all of them
+	if (memory_numa && numa_nodes != 0) {
+		if (shared)
+			syscall(SYS_mbind, p, length, MPOL_INTERLEAVE, &numa_nodes, 8 * sizeof(numa_nodes) + 1, 0);
+		else
+			syscall(SYS_mbind, p, length, MPOL_LOCAL, NULL, 0, 0);
+	}
+	return p;
+}
+
+/**
+ * Unmaps memory from mem_alloc().
+ * @param p: the memory, may be NULL
+ * @param size: the size it was allocated with
+ */
+void mem_free(void* p, size_t size)
+{
+	if (p == NULL)
+		return;
+	if (memory_pages != MEM_PAGES_SMALL && size >= MEM_HUGE_PAGE)
+		size = (size + MEM_HUGE_PAGE - 1) & ~(MEM_HUGE_PAGE - 1);
+	munmap(p, size);
+}
+
+/**
+ * Initializes an empty arena. Chunks are mapped as it grows.
+ * @param a: the arena
+ */
+void arena_init(mem_arena* a)
+{
+	a->first = NULL;
+	a->current = NULL;
+}
+
+/**
+ * Allocates from the arena. Memory is handed out from the current chunk,
+ * moving on to the next chunk (or a new one) when it is full.
+ * @param a: the arena
+ * @param size: bytes
+ * @return uninitialized memory, 16-byte aligned
+ */
+void* arena_alloc(mem_arena* a, size_t size)
+{
+	size_t header = (sizeof(mem_chunk) + 15) & ~(size_t) 15;
+	size = (size + 15) & ~(size_t) 15;
+
+	mem_chunk* c = a->current;
+	while (c != NULL && c->used + size > c->size) {
+		c = c->next;
+		if (c != NULL)
+			c->used = header;
+	}
+	if (c == NULL) {
+		size_t length = (size + header > MEM_ARENA_CHUNK) ? size + header : MEM_ARENA_CHUNK;
+		c = (mem_chunk*) mem_alloc(length, 0);
+		c->size = length;
+		c->used = header;
+		c->clean = header;
+		c->next = NULL;
+		// Append, so a reset walks the chunks in order
+		if (a->current != NULL) {
+			mem_chunk* last = a->current;
+			while (last->next != NULL)
+				last = last->next;
+			last->next = c;
+		} else {
+			a->first = c;
+		}
+	}
+	a->current = c;
+
+	char* p = (char*) c + c->used;
+	c->used += size;
+	return p;
+}
+
+/**
+ * Allocates zero-filled memory from the arena. Only bytes handed out
+ * before the last reset need clearing; the rest are still as the kernel
+ * zeroed them.
+ * @param a: the arena
+ * @param size: bytes
+ * @return zero-filled memory, 16-byte aligned
+ */
+void* arena_calloc(mem_arena* a, size_t size)
+{
+	char* p = arena_alloc(a, size);
+	mem_chunk* c = a->current;
+	size_t start = p - (char*) c;
+	if (start < c->clean)
+		memset(p, 0, ((c->used < c->clean) ? c->used : c->clean) - start);
+	if (c->used > c->clean)
+		c->clean = c->used;
+	return p;
+}
+
+/**
+ * Releases everything allocated from the arena at once. Its chunks are
+ * kept, so the next search reuses memory already mapped and touched.
+ * @param a: the arena
+ */
+void arena_reset(mem_arena* a)
+{
+	a->current = a->first;
+	if (a->first != NULL)
+		a->first->used = (sizeof(mem_chunk) + 15) & ~(size_t) 15;
+}
+
+/**
+ * Unmaps every chunk of the arena and leaves it empty.
+ * @param a: the arena
+ */
+void arena_release(mem_arena* a)
+{
+	mem_chunk* c = a->first;
+	while (c != NULL) {
+		mem_chunk* next = c->next;
+		mem_free(c, c->size);
+		c = next;
+	}
+	arena_init(a);
+}
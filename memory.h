@@ -0,0 +1,52 @@
+/*
+ * memory.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+#ifndef MEMORY_H_
+#define MEMORY_H_
+#include <stddef.h>
+
+/* Page sizes for large allocations */
+#define MEM_PAGES_SMALL 0        /* the system's base pages */
+#define MEM_PAGES_TRANSPARENT 1  /* transparent huge pages, if enabled */
+#define MEM_PAGES_EXPLICIT 2     /* reserved huge pages, else transparent */
+
+#define MEM_HUGE_PAGE (2UL << 20)
+/* Bytes an arena maps at a time */
+#define MEM_ARENA_CHUNK (16UL << 20)
+
+/* A block of an arena; the header sits at the start of the mapping */
+typedef struct mem_chunk {
+	struct mem_chunk* next;
+	size_t size;
+	size_t used;
+	size_t clean;            /* bytes past this are still zero */
+} mem_chunk;
+
+/*
+ * Bump allocator for memory that is all released at once, such as the
+ * nodes of one search.
+ */
+typedef struct mem_arena {
+	mem_chunk* first;
+	mem_chunk* current;
+} mem_arena;
+
+/* Choose page sizes and NUMA placement for later allocations */
+void set_memory(int pages, int numa);
+/* Zero-filled memory; shared memory is spread over NUMA nodes, other
+ * memory stays on the node of the thread that touches it first */
+void* mem_alloc(size_t size, int shared);
+void mem_free(void* p, size_t size);
+
+void arena_init(mem_arena* a);
+/* 16-byte aligned; arena_calloc() zero-fills */
+void* arena_alloc(mem_arena* a, size_t size);
+void* arena_calloc(mem_arena* a, size_t size);
+/* Release everything allocated, keeping the memory for reuse */
+void arena_reset(mem_arena* a);
+/* Unmap the arena's memory */
+void arena_release(mem_arena* a);
+
+#endif /* MEMORY_H_ */
@@ -0,0 +1,430 @@
+/*
+ * nntrain.c
+ *
+ * Trains a network for --eval nn from game logs written with --log. Every
+ * position of every game, and its mirror image, is labelled with the
+ * game's result for player 1: 1 for a win, 0 for a draw, -1 for a loss.
+ * The network is trained in floating point with Adam on the squared error,
+ * its weights clipped so they survive quantization, then quantized to the
+ * layout of nnue.h. A tenth of the games is held out to report the error
+ * on positions the network has not seen.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "bitboard.h"
+#include "gamelog.h"
+#include "nnue.h"
+
+#define USAGE "usage -- ./nntrain [-e epochs] [-a hidden1] [-b hidden2] [-l rate] out log..."
+
+/* Defaults for the options */
+#define TRAIN_EPOCHS 30
+#define TRAIN_HIDDEN1 128
+#define TRAIN_HIDDEN2 32
+#define TRAIN_RATE 0.001f
+/* Positions per gradient step */
+#define TRAIN_BATCH 256
+/* Score of a won position, as in tree.h */
+#define TRAIN_WIN_SCORE 10
+
+void error(char* msg);
+
+/* A labelled position */
+typedef struct sample {
+	uint64_t p1;
+	uint64_t mask;
+	float target;
+} sample;
+
+/* Floating-point network with the shape of an nn_network; first-layer
+ * rows are indexed by player and bitboard bit as in nn_network */
+typedef struct model {
+	int hidden1;
+	int hidden2;
+	float* w1;              /* [128][hidden1] */
+	float* b1;
+	float* w2;              /* [hidden2][hidden1] */
+	float* b2;
+	float* w3;
+	float* b3;
+	int size;               /* parameters in all, laid out in one array */
+	float* params;
+} model;
+
+/* Adam state, one entry per parameter */
+typedef struct adam {
+	float* grad;
+	float* m;
+	float* v;
+	long steps;
+} adam;
+
+/**
+ * Returns a uniform random number in [-a, a].
+ */
+static float uniform(float a)
+{
+	return a * (2.0f * rand() / RAND_MAX - 1.0f);
+}
+
+/**
+ * Lays out a model's parameters in one array and initializes them.
+ */
+static void model_init(model* m, int hidden1, int hidden2)
+{
+	int i;
+	m->hidden1 = hidden1;
+	m->hidden2 = hidden2;
+	m->size = 128 * hidden1 + hidden1 + hidden2 * hidden1 + hidden2 + hidden2 + 1;
+	m->params = calloc(m->size, sizeof(float));
+	if (m->params == NULL) { error("Could not allocate memory for network"); }
+	m->w1 = m->params;
+	m->b1 = m->w1 + 128 * hidden1;
+	m->w2 = m->b1 + hidden1;
+	m->b2 = m->w2 + hidden2 * hidden1;
+	m->w3 = m->b2 + hidden2;
+	m->b3 = m->w3 + hidden2;
+
+	for (i = 0; i < 128 * hidden1; i++)
+		m->w1[i] = uniform(0.1f);
+	for (i = 0; i < hidden1; i++)
+		m->b1[i] = 0.5f;
+	for (i = 0; i < hidden2 * hidden1; i++)
+		m->w2[i] = uniform(1.0f / sqrtf(hidden1));
+	for (i = 0; i < hidden2; i++) {
+		m->b2[i] = 0.5f;
+		m->w3[i] = uniform(1.0f / sqrtf(hidden2));
+	}
+}
+
+/**
+ * Collects the first-layer rows of a position's checkers.
+ */
+static int features(uint64_t p1, uint64_t mask, int* rows)
+{
+	uint64_t p2 = p1 ^ mask;
+	int n = 0;
+	for (; p1; p1 &= p1 - 1)
+		rows[n++] = __builtin_ctzll(p1);
+	for (; p2; p2 &= p2 - 1)
+		rows[n++] = 64 + __builtin_ctzll(p2);
+	return n;
+}
+
+/**
+ * Clips x to [0, 1], the range of an activation.
+ */
+static float clip(float x)
+{
+	return (x < 0.0f) ? 0.0f : (x > 1.0f) ? 1.0f : x;
+}
+
+/**
+ * Runs a position through the model, keeping the first layer's
+ * pre-activations and activations and the second layer's pre-activations
+ * for the backward pass, and returns its output.
+ */
+static float forward(model* m, int* rows, int n, float* z1, float* a1, float* z2)
+{
+	int i, j;
+	memcpy(z1, m->b1, sizeof(float) * m->hidden1);
+	for (j = 0; j < n; j++) {
+		const float* w = m->w1 + rows[j] * m->hidden1;
+		for (i = 0; i < m->hidden1; i++)
+			z1[i] += w[i];
+	}
+	for (i = 0; i < m->hidden1; i++)
+		a1[i] = clip(z1[i]);
+	float y = *m->b3;
+	for (j = 0; j < m->hidden2; j++) {
+		const float* w = m->w2 + j * m->hidden1;
+		float sum = m->b2[j];
+		for (i = 0; i < m->hidden1; i++)
+			sum += a1[i] * w[i];
+		z2[j] = sum;
+		y += clip(sum) * m->w3[j];
+	}
+	return y;
+}
+
+/**
+ * Adds the gradient of one position's squared error to the optimizer's
+ * gradient; the clipped activations pass gradient only inside (0, 1).
+ */
+static void backward(model* m, adam* opt, int* rows, int n, float* z1, float* a1, float* z2, float err)
+{
+	float* g = opt->grad;
+	float* gw1 = g;
+	float* gb1 = gw1 + 128 * m->hidden1;
+	float* gw2 = gb1 + m->hidden1;
+	float* gb2 = gw2 + m->hidden2 * m->hidden1;
+	float* gw3 = gb2 + m->hidden2;
+	float* gb3 = gw3 + m->hidden2;
+	float d1[NN_MAX_HIDDEN1];
+	int i, j;
+
+	*gb3 += err;
+	memset(d1, 0, sizeof(float) * m->hidden1);
+	for (j = 0; j < m->hidden2; j++) {
+		gw3[j] += err * clip(z2[j]);
+		if (z2[j] <= 0.0f || z2[j] >= 1.0f)
+			continue;
+		float d2 = err * m->w3[j];
+		const float* w = m->w2 + j * m->hidden1;
+		float* gw = gw2 + j * m->hidden1;
+		gb2[j] += d2;
+		for (i = 0; i < m->hidden1; i++) {
+			gw[i] += d2 * a1[i];
+			d1[i] += d2 * w[i];
+		}
+	}
+	for (i = 0; i < m->hidden1; i++) {
+		if (z1[i] <= 0.0f || z1[i] >= 1.0f)
+			d1[i] = 0.0f;
+		gb1[i] += d1[i];
+	}
+	for (j = 0; j < n; j++) {
+		float* gw = gw1 + rows[j] * m->hidden1;
+		for (i = 0; i < m->hidden1; i++)
+			gw[i] += d1[i];
+	}
+}
+
+/**
+ * Takes an Adam step with the accumulated gradient, then clips every
+ * weight into the range its quantized form can hold.
+ */
+static void step(model* m, adam* opt, float rate, int count, float limit1)
+{
+	const float beta1 = 0.9f, beta2 = 0.999f, epsilon = 1e-8f;
+	const float limit2 = 127.0f / NN_WEIGHT;
+	float* p = m->params;
+	int i;
+
+	opt->steps++;
+	float correction1 = 1.0f - powf(beta1, opt->steps);
+	float correction2 = 1.0f - powf(beta2, opt->steps);
+	for (i = 0; i < m->size; i++) {
+		float g = opt->grad[i] / count;
+		opt->m[i] = beta1 * opt->m[i] + (1.0f - beta1) * g;
+		opt->v[i] = beta2 * opt->v[i] + (1.0f - beta2) * g * g;
+		p[i] -= rate * (opt->m[i] / correction1) / (sqrtf(opt->v[i] / correction2) + epsilon);
+	}
+	for (i = 0; i < 128 * m->hidden1 + m->hidden1; i++)
+		m->w1[i] = fminf(fmaxf(m->w1[i], -limit1), limit1);
+	for (i = 0; i < m->hidden2 * m->hidden1; i++)
+		m->w2[i] = fminf(fmaxf(m->w2[i], -limit2), limit2);
+	for (i = 0; i < m->hidden2; i++)
+		m->w3[i] = fminf(fmaxf(m->w3[i], -limit2), limit2);
+	memset(opt->grad, 0, sizeof(float) * m->size);
+}
+
+/**
+ * Returns the mean squared error of the model over samples.
+ */
+static double loss(model* m, sample* samples, long count)
+{
+	float z1[NN_MAX_HIDDEN1], a1[NN_MAX_HIDDEN1], z2[NN_MAX_HIDDEN2];
+	int rows[128];
+	double sum = 0;
+	long s;
+	for (s = 0; s < count; s++) {
+		int n = features(samples[s].p1, samples[s].mask, rows);
+		float e = forward(m, rows, n, z1, a1, z2) - samples[s].target;
+		sum += e * e;
+	}
+	return (count > 0) ? sum / count : 0;
+}
+
+/**
+ * Rounds x to the nearest integer.
+ */
+static long quantize(float x)
+{
+	return lroundf(x);
+}
+
+/**
+ * Writes the model quantized as nnue.h describes: first-layer values and
+ * activations scaled by NN_ACTIVATION, int8 weights by NN_WEIGHT.
+ */
+static void write_network(model* m, const char* path, int num_rows, int num_cols, int r)
+{
+	nn_network* net = nn_create(num_rows, num_cols, r, m->hidden1, m->hidden2, TRAIN_WIN_SCORE);
+	int i;
+	if (net == NULL) { error("nntrain: unsupported network size"); }
+	for (i = 0; i < 128 * m->hidden1; i++)
+		net->weights1[i] = quantize(m->w1[i] * NN_ACTIVATION);
+	for (i = 0; i < m->hidden1; i++)
+		net->bias1[i] = quantize(m->b1[i] * NN_ACTIVATION);
+	for (i = 0; i < m->hidden2 * m->hidden1; i++)
+		net->weights2[i] = quantize(m->w2[i] * NN_WEIGHT);
+	for (i = 0; i < m->hidden2; i++) {
+		net->bias2[i] = quantize(m->b2[i] * NN_ACTIVATION * NN_WEIGHT);
+		net->weights3[i] = quantize(m->w3[i] * NN_WEIGHT);
+	}
+	net->bias3 = quantize(*m->b3 * NN_ACTIVATION * NN_WEIGHT);
+	if (nn_save(net, path) != 0) { error("Could not write network"); }
+	nn_delete(net);
+}
+
+/**
+ * Appends a sample, growing the array as needed.
+ */
+static void add_sample(sample** samples, long* count, long* capacity, uint64_t p1, uint64_t mask, float target)
+{
+	if (*count == *capacity) {
+		*capacity = (*capacity == 0) ? 4096 : *capacity * 2;
+		*samples = realloc(*samples, sizeof(sample) * *capacity);
+		if (*samples == NULL) { error("Could not allocate memory for samples"); }
+	}
+	(*samples)[*count].p1 = p1;
+	(*samples)[*count].mask = mask;
+	(*samples)[*count].target = target;
+	(*count)++;
+}
+
+int main(int argc, char* argv[])
+{
+	int epochs = TRAIN_EPOCHS, hidden1 = TRAIN_HIDDEN1, hidden2 = TRAIN_HIDDEN2;
+	float rate = TRAIN_RATE;
+	int option;
+	while ((option = getopt(argc, argv, "e:a:b:l:")) != -1) {
+		switch (option) {
+		case 'e':
+			epochs = strtol(optarg, NULL, 10);
+			break;
+		case 'a':
+			hidden1 = strtol(optarg, NULL, 10);
+			break;
+		case 'b':
+			hidden2 = strtol(optarg, NULL, 10);
+			break;
+		case 'l':
+			rate = strtof(optarg, NULL);
+			break;
+		default:
+			error(USAGE);
+		}
+	}
+	if (argc - optind < 2 || epochs < 1 || rate <= 0) { error(USAGE); }
+	if (hidden1 < NN_CHUNK || hidden1 > NN_MAX_HIDDEN1 || hidden1 % NN_CHUNK != 0 ||
+			hidden2 < 1 || hidden2 > NN_MAX_HIDDEN2) {
+		error("nntrain: hidden1 must be a multiple of 32 up to 512, hidden2 at most 64");
+	}
+	const char* out_path = argv[optind];
+
+	// Replay every game, keeping the positions of the first board size seen
+	sample* held = NULL;
+	long held_count = 0, held_capacity = 0, games = 0;
+	int num_rows = 0, num_cols = 0, r = 0, i;
+	sample* train = NULL;
+	long train_count = 0, train_capacity = 0;
+	for (i = optind + 1; i < argc; i++) {
+		gamelog_reader* reader = gamelog_open(argv[i]);
+		if (reader == NULL) { error("Could not open game log"); }
+		const gl_game* game;
+		const gl_move* moves;
+		while (gamelog_next(reader, &game, &moves)) {
+			if (num_rows == 0) {
+				num_rows = game->row_len;
+				num_cols = game->column_len;
+				r = game->r;
+				if (!bitboard_fits(num_rows, num_cols)) { error("nntrain: board does not fit in a bitboard"); }
+			}
+			if (game->row_len != num_rows || game->column_len != num_cols || game->r != r)
+				continue;
+
+			float target = (game->winner == 1) ? 1.0f : (game->winner == 2) ? -1.0f : 0.0f;
+			// Every tenth game is held out
+			int validation = (games++ % 10 == 9);
+			bitboard bb, mirrored;
+			int m;
+			memset(&bb, 0, sizeof(bb));
+			bb.row_len = num_rows;
+			bb.column_len = num_cols;
+			bb.r = r;
+			for (m = 0; m < game->num_moves; m++) {
+				int col = moves[m].column;
+				if (col < 0 || col >= num_cols)
+					break;
+				uint64_t cell = (bb.mask + bottom_mask(num_rows, num_cols)) & column_mask(num_rows, col);
+				if (cell == 0)
+					break;
+				// The final winning move is scored by the evaluator itself
+				if (m == game->num_moves - 1 && game->winner != 0)
+					break;
+				bb.mask |= cell;
+				if (moves[m].player == 1)
+					bb.p1 |= cell;
+				bitboard_mirror(&bb, &mirrored);
+				if (validation) {
+					add_sample(&held, &held_count, &held_capacity, bb.p1, bb.mask, target);
+				} else {
+					add_sample(&train, &train_count, &train_capacity, bb.p1, bb.mask, target);
+					add_sample(&train, &train_count, &train_capacity, mirrored.p1, mirrored.mask, target);
+				}
+			}
+		}
+		gamelog_release(reader);
+	}
+	if (train_count == 0) { error("nntrain: no positions to train on"); }
+	printf("%ld games, %ld training positions (mirrors included), %ld held out\n", games,
+			train_count, held_count);
+
+	// First-layer sums of up to every cell must fit in int16
+	float limit1 = 32000.0f / NN_ACTIVATION / (num_rows * num_cols + 1);
+	model m;
+	adam opt;
+	srand(1);
+	model_init(&m, hidden1, hidden2);
+	opt.grad = calloc(m.size, sizeof(float));
+	opt.m = calloc(m.size, sizeof(float));
+	opt.v = calloc(m.size, sizeof(float));
+	opt.steps = 0;
+	if (opt.grad == NULL || opt.m == NULL || opt.v == NULL) { error("Could not allocate memory for training"); }
+
+	float z1[NN_MAX_HIDDEN1], a1[NN_MAX_HIDDEN1], z2[NN_MAX_HIDDEN2];
+	int rows[128];
+	int epoch;
+	for (epoch = 1; epoch <= epochs; epoch++) {
+		long s, in_batch = 0;
+		for (s = train_count - 1; s > 0; s--) {
+			long k = ((long) rand() * RAND_MAX + rand()) % (s + 1);
+			sample t = train[s];
+			train[s] = train[k];
+			train[k] = t;
+		}
+		for (s = 0; s < train_count; s++) {
+			int n = features(train[s].p1, train[s].mask, rows);
+			float e = forward(&m, rows, n, z1, a1, z2) - train[s].target;
+			backward(&m, &opt, rows, n, z1, a1, z2, e);
+			if (++in_batch == TRAIN_BATCH || s == train_count - 1) {
+				step(&m, &opt, rate, in_batch, limit1);
+				in_batch = 0;
+			}
+		}
+		printf("epoch %d: training error %.4f, held-out error %.4f\n", epoch,
+				loss(&m, train, train_count), loss(&m, held, held_count));
+		fflush(stdout);
+	}
+
+	write_network(&m, out_path, num_rows, num_cols, r);
+	printf("Wrote %s: %dx%d r=%d, layers %d and %d\n", out_path, num_rows, num_cols, r, hidden1, hidden2);
+	free(m.params);
+	free(opt.grad);
+	free(opt.m);
+	free(opt.v);
+	free(held);
+	free(train);
+	return 0;
+}
+
+void error(char* msg)
+{
+	printf("%s\n", msg);
+	exit(1);
+}
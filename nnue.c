@@ -0,0 +1,472 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include "bitboard.h"
+#include "threat.h"
+#include "nnue.h"
+
+/**
+ * Allocates zeroed memory aligned for the vector kernels.
+ */
+static void* alloc_aligned(size_t size)
+{
+	void* p = NULL;
+	size = (size + NN_CHUNK - 1) & ~(size_t) (NN_CHUNK - 1);
+	if (posix_memalign(&p, NN_CHUNK, size) != 0)
+		return NULL;
+	memset(p, 0, size);
+	return p;
+}
+
+/**
+ * Creates a network with every weight and bias zero.
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ * @param r: number of checkers in a row needed to win
+ * @param hidden1: width of the first layer, a multiple of NN_CHUNK
+ * @param hidden2: width of the second layer
+ * @param win_score: score of a won position for player 1
+ * @return the network, or NULL if the sizes are not supported
+ */
+nn_network* nn_create(int num_rows, int num_cols, int r, int hidden1, int hidden2, int win_score)
+{
+	if (!bitboard_fits(num_rows, num_cols) || hidden1 < NN_CHUNK || hidden1 > NN_MAX_HIDDEN1 ||
+			hidden1 % NN_CHUNK != 0 || hidden2 < 1 || hidden2 > NN_MAX_HIDDEN2)
+		return NULL;
+
+	nn_network* net = (nn_network*) calloc(1, sizeof(nn_network));
+	if (net == NULL)
+		return NULL;
+	net->row_len = num_rows;
+	net->column_len = num_cols;
+	net->r = r;
+	net->hidden1 = hidden1;
+	net->hidden2 = hidden2;
+	net->win_score = win_score;
+	net->bias1 = alloc_aligned(sizeof(int16_t) * hidden1);
+	net->weights1 = alloc_aligned(sizeof(int16_t) * 2 * 64 * hidden1);
+	net->bias2 = alloc_aligned(sizeof(int32_t) * hidden2);
+	net->weights2 = alloc_aligned((size_t) hidden2 * hidden1);
+	net->weights3 = alloc_aligned(hidden2);
+	if (net->bias1 == NULL || net->weights1 == NULL || net->bias2 == NULL ||
+			net->weights2 == NULL || net->weights3 == NULL) {
+		nn_delete(net);
+		return NULL;
+	}
+#if defined(__x86_64__)
+	net->avx2 = __builtin_cpu_supports("avx2");
+#else
+	net->avx2 = 0;
+#endif
+	return net;
+}
+
+/**
+ * Deallocates a network.
+ * @param net: the network, may be NULL
+ */
+void nn_delete(nn_network* net)
+{
+	if (net == NULL)
+		return;
+	free(net->bias1);
+	free(net->weights1);
+	free(net->bias2);
+	free(net->weights2);
+	free(net->weights3);
+	free(net);
+}
+
+/**
+ * Returns the first-layer row of a player's checker in a cell of the file
+ * layout, which lives at the cell's bitboard bit.
+ */
+static int16_t* feature_row(nn_network* net, int player, int col, int row)
+{
+	int bit = col * (net->row_len + 1) + row;
+	return net->weights1 + ((player - 1) * 64 + bit) * net->hidden1;
+}
+
+/**
+ * Folds bytes into an FNV-1a hash.
+ */
+static uint64_t hash_bytes(uint64_t h, const void* data, size_t length)
+{
+	const unsigned char* p = data;
+	size_t i;
+	for (i = 0; i < length; i++) {
+		h ^= p[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+/**
+ * Returns a hash of a network's sizes and weights, which tells networks
+ * apart wherever their scores are kept.
+ */
+static uint64_t network_hash(nn_network* net)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	h = hash_bytes(h, &net->hidden1, sizeof(int));
+	h = hash_bytes(h, &net->hidden2, sizeof(int));
+	h = hash_bytes(h, net->bias1, sizeof(int16_t) * net->hidden1);
+	h = hash_bytes(h, net->weights1, sizeof(int16_t) * 2 * 64 * net->hidden1);
+	h = hash_bytes(h, net->bias2, sizeof(int32_t) * net->hidden2);
+	h = hash_bytes(h, net->weights2, (size_t) net->hidden2 * net->hidden1);
+	h = hash_bytes(h, &net->bias3, sizeof(int32_t));
+	return hash_bytes(h, net->weights3, net->hidden2);
+}
+
+/**
+ * Loads a network written by nn_save().
+ * @param path: the network file
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ * @param r: number of checkers in a row needed to win
+ * @param win_score: score of a won position for player 1
+ * @return the network, or NULL if the file cannot be read, is not a
+ * network, or was trained for another board
+ */
+nn_network* nn_load(const char* path, int num_rows, int num_cols, int r, int win_score)
+{
+	FILE* in = fopen(path, "rb");
+	if (in == NULL)
+		return NULL;
+
+	nn_file header;
+	nn_network* net = NULL;
+	if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, NN_MAGIC, 4) != 0 ||
+			header.version != NN_VERSION || header.row_len != num_rows ||
+			header.column_len != num_cols || header.r != r)
+		goto fail;
+	net = nn_create(num_rows, num_cols, r, header.hidden1, header.hidden2, win_score);
+	if (net == NULL)
+		goto fail;
+
+	int player, col, row, ok;
+	ok = fread(net->bias1, sizeof(int16_t), net->hidden1, in) == (size_t) net->hidden1;
+	for (player = 1; player <= 2; player++) {
+		for (col = 0; col < num_cols; col++) {
+			for (row = 0; row < num_rows; row++) {
+				ok = ok && fread(feature_row(net, player, col, row), sizeof(int16_t), net->hidden1, in) ==
+						(size_t) net->hidden1;
+			}
+		}
+	}
+	ok = ok && fread(net->bias2, sizeof(int32_t), net->hidden2, in) == (size_t) net->hidden2;
+	ok = ok && fread(net->weights2, 1, (size_t) net->hidden2 * net->hidden1, in) ==
+			(size_t) net->hidden2 * net->hidden1;
+	ok = ok && fread(&net->bias3, sizeof(int32_t), 1, in) == 1;
+	ok = ok && fread(net->weights3, 1, net->hidden2, in) == (size_t) net->hidden2;
+	if (!ok)
+		goto fail;
+	fclose(in);
+	net->hash = network_hash(net);
+	return net;
+
+fail:
+	nn_delete(net);
+	fclose(in);
+	return NULL;
+}
+
+/**
+ * Writes a network in the layout nn_load() reads.
+ * @param net: the network
+ * @param path: the file to write
+ * @return 0 on success, 1 on failure
+ */
+int nn_save(nn_network* net, const char* path)
+{
+	FILE* out = fopen(path, "wb");
+	if (out == NULL)
+		return 1;
+
+	nn_file header;
+	int player, col, row;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, NN_MAGIC, 4);
+	header.version = NN_VERSION;
+	header.row_len = net->row_len;
+	header.column_len = net->column_len;
+	header.r = net->r;
+	header.hidden1 = net->hidden1;
+	header.hidden2 = net->hidden2;
+
+	fwrite(&header, sizeof(header), 1, out);
+	fwrite(net->bias1, sizeof(int16_t), net->hidden1, out);
+	for (player = 1; player <= 2; player++) {
+		for (col = 0; col < net->column_len; col++) {
+			for (row = 0; row < net->row_len; row++)
+				fwrite(feature_row(net, player, col, row), sizeof(int16_t), net->hidden1, out);
+		}
+	}
+	fwrite(net->bias2, sizeof(int32_t), net->hidden2, out);
+	fwrite(net->weights2, 1, (size_t) net->hidden2 * net->hidden1, out);
+	fwrite(&net->bias3, sizeof(int32_t), 1, out);
+	fwrite(net->weights3, 1, net->hidden2, out);
+	return (fclose(out) == 0) ? 0 : 1;
+}
+
+/**
+ * Adds sign times a first-layer row to an accumulator.
+ */
+static void update_scalar(nn_network* net, int16_t* values, const int16_t* row, int sign)
+{
+	int i;
+	if (sign > 0) {
+		for (i = 0; i < net->hidden1; i++)
+			values[i] += row[i];
+	} else {
+		for (i = 0; i < net->hidden1; i++)
+			values[i] -= row[i];
+	}
+}
+
+/**
+ * Runs the layers above the accumulator and returns the raw output, in
+ * units of NN_ACTIVATION * NN_WEIGHT.
+ */
+static int32_t forward_scalar(nn_network* net, const int16_t* values)
+{
+	uint8_t input[NN_MAX_HIDDEN1];
+	int32_t output = net->bias3;
+	int i, j;
+
+	for (i = 0; i < net->hidden1; i++)
+		input[i] = (values[i] < 0) ? 0 : (values[i] > NN_ACTIVATION) ? NN_ACTIVATION : values[i];
+	for (j = 0; j < net->hidden2; j++) {
+		const int8_t* w = net->weights2 + j * net->hidden1;
+		int32_t sum = net->bias2[j];
+		for (i = 0; i < net->hidden1; i++)
+			sum += input[i] * w[i];
+		sum >>= NN_WEIGHT_SHIFT;
+		output += ((sum < 0) ? 0 : (sum > NN_ACTIVATION) ? NN_ACTIVATION : sum) * net->weights3[j];
+	}
+	return output;
+}
+
+#if defined(__x86_64__)
+/**
+ * Vector form of update_scalar(), sixteen units at a time. Accumulators
+ * may sit in memory that is not 32-byte aligned, such as a malloc()ed
+ * struct; weight rows always are.
+ */
+__attribute__((target("avx2")))
+static void update_avx2(nn_network* net, int16_t* values, const int16_t* row, int sign)
+{
+	int i;
+	for (i = 0; i < net->hidden1; i += 16) {
+		__m256i v = _mm256_loadu_si256((const __m256i*) (values + i));
+		__m256i w = _mm256_load_si256((const __m256i*) (row + i));
+		v = (sign > 0) ? _mm256_add_epi16(v, w) : _mm256_sub_epi16(v, w);
+		_mm256_storeu_si256((__m256i*) (values + i), v);
+	}
+}
+
+/**
+ * Vector form of forward_scalar(). The accumulator is clipped by packing
+ * it to int8 with saturation; the unsigned by signed byte products of the
+ * second layer fit in int16 pairs, so nothing saturates there and the
+ * result matches the scalar code.
+ */
+__attribute__((target("avx2")))
+static int32_t forward_avx2(nn_network* net, const int16_t* values)
+{
+	uint8_t input[NN_MAX_HIDDEN1] __attribute__((aligned(32)));
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i ones = _mm256_set1_epi16(1);
+	int32_t output = net->bias3;
+	int i, j;
+
+	for (i = 0; i < net->hidden1; i += NN_CHUNK) {
+		__m256i lo = _mm256_loadu_si256((const __m256i*) (values + i));
+		__m256i hi = _mm256_loadu_si256((const __m256i*) (values + i + 16));
+		// Packing interleaves the 128-bit lanes; the permute restores order
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(lo, hi), 0xd8);
+		_mm256_store_si256((__m256i*) (input + i), _mm256_max_epi8(packed, zero));
+	}
+	// Four units at a time: their sums are reduced together with hadd
+	__m128i units = _mm_setzero_si128();
+	for (j = 0; j + 4 <= net->hidden2; j += 4) {
+		const int8_t* w0 = net->weights2 + j * net->hidden1;
+		const int8_t* w1 = w0 + net->hidden1;
+		const int8_t* w2 = w1 + net->hidden1;
+		const int8_t* w3 = w2 + net->hidden1;
+		__m256i s0 = zero, s1 = zero, s2 = zero, s3 = zero;
+		for (i = 0; i < net->hidden1; i += NN_CHUNK) {
+			__m256i a = _mm256_load_si256((const __m256i*) (input + i));
+			s0 = _mm256_add_epi32(s0, _mm256_madd_epi16(_mm256_maddubs_epi16(a, _mm256_load_si256((const __m256i*) (w0 + i))), ones));
+			s1 = _mm256_add_epi32(s1, _mm256_madd_epi16(_mm256_maddubs_epi16(a, _mm256_load_si256((const __m256i*) (w1 + i))), ones));
+			s2 = _mm256_add_epi32(s2, _mm256_madd_epi16(_mm256_maddubs_epi16(a, _mm256_load_si256((const __m256i*) (w2 + i))), ones));
+			s3 = _mm256_add_epi32(s3, _mm256_madd_epi16(_mm256_maddubs_epi16(a, _mm256_load_si256((const __m256i*) (w3 + i))), ones));
+		}
+		__m256i pairs = _mm256_hadd_epi32(_mm256_hadd_epi32(s0, s1), _mm256_hadd_epi32(s2, s3));
+		__m128i u = _mm_add_epi32(_mm256_castsi256_si128(pairs), _mm256_extracti128_si256(pairs, 1));
+		u = _mm_srai_epi32(_mm_add_epi32(u, _mm_loadu_si128((const __m128i*) (net->bias2 + j))), NN_WEIGHT_SHIFT);
+		u = _mm_min_epi32(_mm_max_epi32(u, _mm_setzero_si128()), _mm_set1_epi32(NN_ACTIVATION));
+		__m128i out = _mm_cvtepi8_epi32(_mm_cvtsi32_si128(*(const int32_t*) (net->weights3 + j)));
+		units = _mm_add_epi32(units, _mm_mullo_epi32(u, out));
+	}
+	units = _mm_add_epi32(units, _mm_shuffle_epi32(units, 0x4e));
+	units = _mm_add_epi32(units, _mm_shuffle_epi32(units, 0xb1));
+	output += _mm_cvtsi128_si32(units);
+	for (; j < net->hidden2; j++) {
+		const int8_t* w = net->weights2 + j * net->hidden1;
+		int32_t sum = net->bias2[j];
+		for (i = 0; i < net->hidden1; i++)
+			sum += input[i] * w[i];
+		sum >>= NN_WEIGHT_SHIFT;
+		output += ((sum < 0) ? 0 : (sum > NN_ACTIVATION) ? NN_ACTIVATION : sum) * net->weights3[j];
+	}
+	return output;
+}
+#endif
+
+/**
+ * Adds or removes a player's checker in a cell.
+ */
+static void update(nn_network* net, nn_accumulator* acc, uint64_t cell, int player, int sign)
+{
+	const int16_t* row = net->weights1 + ((player - 1) * 64 + __builtin_ctzll(cell)) * net->hidden1;
+#if defined(__x86_64__)
+	if (net->avx2) {
+		update_avx2(net, acc->values, row, sign);
+		return;
+	}
+#endif
+	update_scalar(net, acc->values, row, sign);
+}
+
+/**
+ * Computes an accumulator from scratch.
+ * @param net: the network
+ * @param acc: the accumulator to fill
+ * @param p1: player 1's checkers
+ * @param mask: occupied cells
+ */
+void nn_refresh(nn_network* net, nn_accumulator* acc, uint64_t p1, uint64_t mask)
+{
+	uint64_t p2 = p1 ^ mask;
+	memcpy(acc->values, net->bias1, sizeof(int16_t) * net->hidden1);
+	for (; p1; p1 &= p1 - 1)
+		update(net, acc, p1 & -p1, 1, 1);
+	for (; p2; p2 &= p2 - 1)
+		update(net, acc, p2 & -p2, 2, 1);
+}
+
+/**
+ * Adds a checker to an accumulator's position.
+ * @param net: the network
+ * @param acc: the accumulator
+ * @param cell: the checker's bitboard bit
+ * @param player: the checker's owner, 1 or 2
+ */
+void nn_add(nn_network* net, nn_accumulator* acc, uint64_t cell, int player)
+{
+	update(net, acc, cell, player, 1);
+}
+
+/**
+ * Takes a checker back from an accumulator's position.
+ * @param net: the network
+ * @param acc: the accumulator
+ * @param cell: the checker's bitboard bit
+ * @param player: the checker's owner, 1 or 2
+ */
+void nn_remove(nn_network* net, nn_accumulator* acc, uint64_t cell, int player)
+{
+	update(net, acc, cell, player, -1);
+}
+
+/**
+ * Scores an accumulator's position for player 1, inside the open range
+ * between the two win scores.
+ * @param net: the network
+ * @param acc: the accumulator
+ */
+int nn_evaluate(nn_network* net, nn_accumulator* acc)
+{
+	const int32_t one = NN_ACTIVATION * NN_WEIGHT;
+	int32_t output;
+#if defined(__x86_64__)
+	if (net->avx2)
+		output = forward_avx2(net, acc->values);
+	else
+#endif
+		output = forward_scalar(net, acc->values);
+
+	int limit = net->win_score - 1;
+	int64_t scaled = (int64_t) output * limit;
+	int score = (scaled + ((scaled < 0) ? -one / 2 : one / 2)) / one;
+	return (score > limit) ? limit : (score < -limit) ? -limit : score;
+}
+
+/**
+ * Returns whether stones hold r in a row.
+ */
+static int completed(nn_network* net, uint64_t stones)
+{
+	int h = net->row_len + 1;
+	int dirs[4] = { 1, h, h - 1, h + 1 };
+	int d, i;
+	for (d = 0; d < 4; d++) {
+		uint64_t run = stones;
+		for (i = 1; i < net->r && run; i++)
+			run &= (i * dirs[d] >= 64) ? 0 : stones >> (i * dirs[d]);
+		if (run)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Scores a position for player 1, building its accumulator from scratch.
+ * Completed lines score the win score.
+ * @param net: the network
+ * @param bb: the position
+ */
+int nn_position(nn_network* net, bitboard* bb)
+{
+	nn_accumulator acc;
+	if (completed(net, bb->p1))
+		return net->win_score;
+	if (completed(net, bb->p1 ^ bb->mask))
+		return -net->win_score;
+	nn_refresh(net, &acc, bb->p1, bb->mask);
+	return nn_evaluate(net, &acc);
+}
+
+/**
+ * Scores the positions one move after a position. The position's
+ * accumulator is built once; each move's checker is added to it, scored
+ * and taken back. Moves that complete a line score the win score.
+ * @param net: the network
+ * @param bb: the position, which must not hold a completed line
+ * @param player: the player moving, 1 or 2
+ * @param cells: the bitboard bit each move fills
+ * @param scores: filled with one score per move
+ * @param count: number of moves
+ */
+void nn_moves(nn_network* net, bitboard* bb, int player, const uint64_t* cells, int* scores, int count)
+{
+	nn_accumulator acc;
+	uint64_t own = (player == 1) ? bb->p1 : bb->p1 ^ bb->mask;
+	uint64_t wins = winning_cells(own, bb->mask, net->row_len, net->column_len, net->r);
+	int i;
+
+	nn_refresh(net, &acc, bb->p1, bb->mask);
+	for (i = 0; i < count; i++) {
+		if (cells[i] & wins) {
+			scores[i] = (player == 1) ? net->win_score : -net->win_score;
+			continue;
+		}
+		nn_add(net, &acc, cells[i], player);
+		scores[i] = nn_evaluate(net, &acc);
+		nn_remove(net, &acc, cells[i], player);
+	}
+}
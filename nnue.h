@@ -0,0 +1,102 @@
+/*
+ * nnue.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+#ifndef NNUE_H_
+#define NNUE_H_
+#include <stdint.h>
+#include "bitboard.h"
+
+#define NN_MAGIC "C4NN"
+#define NN_VERSION 1
+
+/* Widest layers a network file may have; the first must be a multiple of
+ * NN_CHUNK, the vector width of the kernels in bytes */
+#define NN_MAX_HIDDEN1 512
+#define NN_MAX_HIDDEN2 64
+#define NN_CHUNK 32
+
+/* Quantized 1.0 of an activation, and of an int8 weight */
+#define NN_ACTIVATION 127
+#define NN_WEIGHT 64
+/* log2 of NN_WEIGHT, the shift that rescales the second layer */
+#define NN_WEIGHT_SHIFT 6
+
+/*
+ * A network file is an nn_file header followed, little endian, by
+ *   int16 bias1[hidden1]
+ *   int16 weights1[2 * row_len * column_len][hidden1]
+ *   int32 bias2[hidden2]
+ *   int8  weights2[hidden2][hidden1]
+ *   int32 bias3
+ *   int8  weights3[hidden2]
+ * Input feature (player - 1) * row_len * column_len + col * row_len + row
+ * is set when player has a checker in that cell, row 0 at the bottom.
+ */
+typedef struct nn_file {
+	char magic[4];
+	uint32_t version;
+	uint8_t row_len;
+	uint8_t column_len;
+	uint8_t r;
+	uint8_t reserved;
+	uint16_t hidden1;
+	uint16_t hidden2;
+} nn_file;
+
+/*
+ * Small quantized network scoring positions for player 1. The first layer
+ * is a sum of one weight row per checker, kept in an accumulator that is
+ * updated as checkers are added and removed; clipped to 0..NN_ACTIVATION
+ * it feeds an int8 layer of hidden2 units and a single int8 output, where
+ * NN_ACTIVATION * NN_WEIGHT stands for a won position. AVX2 kernels are
+ * used when the processor has them, scalar code otherwise, with the same
+ * results. Boards that fit in a bitboard only.
+ */
+typedef struct nn_network {
+	int row_len;
+	int column_len;
+	int r;
+	int hidden1;
+	int hidden2;
+	int win_score;
+	int avx2;
+	int16_t* bias1;
+	int16_t* weights1;      /* [2][64][hidden1], rows by player and bitboard bit */
+	int32_t* bias2;
+	int8_t* weights2;       /* [hidden2][hidden1] */
+	int32_t bias3;
+	int8_t* weights3;       /* [hidden2] */
+	uint64_t hash;          /* of the layer sizes and weights, set by nn_load() */
+} nn_network;
+
+/* First layer sums for one position */
+typedef struct nn_accumulator {
+	int16_t values[NN_MAX_HIDDEN1] __attribute__((aligned(32)));
+} nn_accumulator;
+
+/* A zeroed network, for a trainer to fill */
+nn_network* nn_create(int num_rows, int num_cols, int r, int hidden1, int hidden2, int win_score);
+/* NULL when the file is missing, malformed, or for another board */
+nn_network* nn_load(const char* path, int num_rows, int num_cols, int r, int win_score);
+/* 0 on success */
+int nn_save(nn_network* net, const char* path);
+void nn_delete(nn_network* net);
+
+/*
+ * Accumulator functions; cell is a single bitboard bit
+ */
+void nn_refresh(nn_network* net, nn_accumulator* acc, uint64_t p1, uint64_t mask);
+void nn_add(nn_network* net, nn_accumulator* acc, uint64_t cell, int player);
+void nn_remove(nn_network* net, nn_accumulator* acc, uint64_t cell, int player);
+/* Score an accumulator's position, which must not hold a completed line */
+int nn_evaluate(nn_network* net, nn_accumulator* acc);
+
+/* Score a position from scratch */
+int nn_position(nn_network* net, bitboard* bb);
+/* Score the positions after each of count moves by player from bb, one
+ * cell each, updating a single accumulator */
+void nn_moves(nn_network* net, bitboard* bb, int player, const uint64_t* cells, int* scores, int count);
+
+#endif /* NNUE_H_ */
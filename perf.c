@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perf.h"
+
+int perf_enabled = 0;
+
+static const char* event_names[PERF_EVENTS] = {
+	"cycles", "instructions", "cache-misses", "branch-misses", "dTLB-misses"
+};
+static const char* phase_names[PERF_PHASES] = { "search", "generate", "eval", "terminal" };
+
+/* Counter file descriptors, -1 for events the machine does not have */
+static int fds[PERF_EVENTS] = { -1, -1, -1, -1, -1 };
+/* User page of each counter, NULL when it cannot be read with rdpmc */
+static struct perf_event_mmap_page* pages[PERF_EVENTS];
+static int group = -1;
+
+static perf_counts totals[PERF_PHASES];
+static perf_counts starts[PERF_PHASES];
+
+/**
+ * Returns the perf_event_attr of an event.
+ */
+static void event_attr(int event, struct perf_event_attr* attr)
+{
+	memset(attr, 0, sizeof(*attr));
+	attr->size = sizeof(*attr);
+	attr->type = PERF_TYPE_HARDWARE;
+	attr->exclude_kernel = 1;
+	attr->exclude_hv = 1;
+	attr->read_format = PERF_FORMAT_GROUP;
+	switch (event) {
+	case PERF_CYCLES:
+		attr->config = PERF_COUNT_HW_CPU_CYCLES;
+		break;
+	case PERF_INSTRUCTIONS:
+		attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+		break;
+	case PERF_CACHE_MISSES:
+		attr->config = PERF_COUNT_HW_CACHE_MISSES;
+		break;
+	case PERF_BRANCH_MISSES:
+		attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+		break;
+	case PERF_TLB_MISSES:
+		attr->type = PERF_TYPE_HW_CACHE;
+		attr->config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+				(PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+		break;
+	}
+}
+
+/**
+ * Opens the counters as one group on the calling thread, so they are
+ * scheduled together. Events the processor or kernel do not offer (a
+ * virtual machine may offer none) are left out of the report.
+ * @return the number of events being counted
+ */
+int perf_open()
+{
+	int i, opened = 0;
+
+	for (i = 0; i < PERF_EVENTS; i++) {
+		struct perf_event_attr attr;
+		event_attr(i, &attr);
+		// The leader starts disabled and enables the group below
+		attr.disabled = (group < 0);
+		fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+		pages[i] = NULL;
+		if (fds[i] < 0)
+			continue;
+		if (group < 0)
+			group = fds[i];
+		opened++;
+
+		// Counters the process may read with rdpmc are read without a
+		// system call, which would otherwise swamp short phases
+		void* page = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fds[i], 0);
+		if (page != MAP_FAILED)
+			pages[i] = (struct perf_event_mmap_page*) page;
+	}
+	if (group >= 0)
+		ioctl(group, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+	memset(totals, 0, sizeof(totals));
+	perf_enabled = 1;
+	return opened;
+}
+
+/**
+ * Stops counting and closes the counters.
+ */
+void perf_close()
+{
+	int i;
+	perf_enabled = 0;
+	for (i = 0; i < PERF_EVENTS; i++) {
+		if (pages[i] != NULL)
+			munmap(pages[i], sysconf(_SC_PAGESIZE));
+		if (fds[i] >= 0)
+			close(fds[i]);
+		pages[i] = NULL;
+		fds[i] = -1;
+	}
+	group = -1;
+}
+
+/**
+ * Reads a counter through its user page, following the sequence lock
+ * protocol of perf_event_open(2).
+ * @return 0 on success, -1 when the counter is not readable this way
+ */
+static int read_rdpmc(struct perf_event_mmap_page* page, uint64_t* value)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	uint32_t seq, index;
+	uint64_t count;
+	do {
+		seq = page->lock;
+		__sync_synchronize();
+		index = page->index;
+		count = page->offset;
+		if (!page->cap_user_rdpmc || index == 0)
+			return -1;
+		uint32_t lo, hi;
+		__asm__ volatile("rdpmc" : "=a" (lo), "=d" (hi) : "c" (index - 1));
+		int64_t pmc = ((uint64_t) hi << 32) | lo;
+		// Sign-extend from the counter's width
+		pmc <<= 64 - page->pmc_width;
+		pmc >>= 64 - page->pmc_width;
+		count += pmc;
+		__sync_synchronize();
+	} while (page->lock != seq);
+	*value = count;
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+/**
+ * Takes a snapshot of every counter and the clock.
+ */
+static void snapshot(perf_counts* c)
+{
+	struct timespec now;
+	int i, fast = 1;
+
+	for (i = 0; i < PERF_EVENTS && fast; i++) {
+		if (fds[i] >= 0 && (pages[i] == NULL || read_rdpmc(pages[i], &c->value[i]) != 0))
+			fast = 0;
+	}
+	if (!fast && group >= 0) {
+		// One read of the group returns its counters in opening order
+		uint64_t buf[PERF_EVENTS + 1];
+		int n = 0;
+		if (read(group, buf, sizeof(buf)) > 0) {
+			for (i = 0; i < PERF_EVENTS; i++) {
+				if (fds[i] >= 0)
+					c->value[i] = buf[1 + n++];
+			}
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	c->ns = (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * Starts a span of a phase; see perf_begin().
+ * @param phase: PERF_SEARCH, PERF_GENERATE, PERF_EVAL or PERF_TERMINAL
+ */
+void perf_phase_begin(int phase)
+{
+	snapshot(&starts[phase]);
+}
+
+/**
+ * Ends a span of a phase and adds it to the phase's totals.
+ * @param phase: the phase given to perf_phase_begin()
+ */
+void perf_phase_end(int phase)
+{
+	perf_counts now;
+	int i;
+	snapshot(&now);
+	for (i = 0; i < PERF_EVENTS; i++) {
+		totals[phase].value[i] += now.value[i] - starts[phase].value[i];
+	}
+	totals[phase].ns += now.ns - starts[phase].ns;
+	totals[phase].calls++;
+}
+
+/**
+ * Clears the phase totals.
+ */
+void perf_reset()
+{
+	memset(totals, 0, sizeof(totals));
+}
+
+/**
+ * Prints one line per phase that ran: its time and share of the search,
+ * nodes per second, and each counter per search node, with instructions
+ * per cycle when both are counted. Times include the counters' overhead.
+ * @param label: printed at the start of every line
+ * @param nodes: nodes searched, the denominator of the ratios
+ */
+void perf_report(const char* label, long nodes)
+{
+	int p, i;
+	double per = (nodes > 0) ? (double) nodes : 1.0;
+
+	for (p = 0; p < PERF_PHASES; p++) {
+		perf_counts* c = &totals[p];
+		if (c->calls == 0)
+			continue;
+		printf("%s %-8s %8.2f ms", label, phase_names[p], c->ns / 1e6);
+		if (p == PERF_SEARCH)
+			printf(" %9.0f nodes/s", (c->ns > 0) ? nodes / (c->ns / 1e9) : 0.0);
+		else
+			printf(" %9llu calls", (unsigned long long) c->calls);
+		for (i = 0; i < PERF_EVENTS; i++) {
+			if (fds[i] >= 0)
+				printf(" %s/node %.1f", event_names[i], c->value[i] / per);
+		}
+		if (fds[PERF_CYCLES] >= 0 && fds[PERF_INSTRUCTIONS] >= 0 && c->value[PERF_CYCLES] > 0)
+			printf(" IPC %.2f", (double) c->value[PERF_INSTRUCTIONS] / c->value[PERF_CYCLES]);
+		printf("\n");
+	}
+}
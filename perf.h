@@ -0,0 +1,59 @@
+/*
+ * perf.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+#ifndef PERF_H_
+#define PERF_H_
+#include <stdint.h>
+
+/* Hardware events counted */
+#define PERF_CYCLES 0
+#define PERF_INSTRUCTIONS 1
+#define PERF_CACHE_MISSES 2
+#define PERF_BRANCH_MISSES 3
+#define PERF_TLB_MISSES 4
+#define PERF_EVENTS 5
+
+/* Phases measured; eval and terminal run inside search */
+#define PERF_SEARCH 0
+#define PERF_GENERATE 1
+#define PERF_EVAL 2
+#define PERF_TERMINAL 3
+#define PERF_PHASES 4
+
+/* Counts accumulated over every span of a phase */
+typedef struct perf_counts {
+	uint64_t value[PERF_EVENTS];
+	uint64_t ns;
+	uint64_t calls;
+} perf_counts;
+
+/* Non-zero between perf_open() and perf_close() */
+extern int perf_enabled;
+
+/* Count the events on the calling thread; returns the number available */
+int perf_open();
+void perf_close();
+/* Clear the phase totals */
+void perf_reset();
+/* Print the phase totals with per-node ratios */
+void perf_report(const char* label, long nodes);
+void perf_phase_begin(int phase);
+void perf_phase_end(int phase);
+
+/* Start a span of phase; spans of one phase must not nest */
+static inline void perf_begin(int phase)
+{
+	if (perf_enabled)
+		perf_phase_begin(phase);
+}
+
+/* End the span started with perf_begin() */
+static inline void perf_end(int phase)
+{
+	if (perf_enabled)
+		perf_phase_end(phase);
+}
+
+#endif /* PERF_H_ */
@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+#include "bitboard.h"
+#include "tree.h"
+#include "rcache.h"
+
+/**
+ * Creates an empty result cache.
+ * @param capacity: the most decisions kept, at least 1
+ * @return the cache
+ */
+result_cache* rc_create(int capacity)
+{
+	result_cache* rc = (result_cache*) calloc(1, sizeof(result_cache));
+	if (rc == NULL) { error("Could not allocate memory for result cache"); }
+	rc->capacity = capacity;
+	rc->entries = (rc_entry*) malloc(sizeof(rc_entry) * capacity);
+	rc->num_buckets = 1;
+	while (rc->num_buckets < capacity)
+		rc->num_buckets *= 2;
+	rc->buckets = (int*) malloc(sizeof(int) * rc->num_buckets);
+	if (rc->entries == NULL || rc->buckets == NULL) { error("Could not allocate memory for result cache"); }
+	rc->epoch = get_search_epoch();
+	rc_clear(rc);
+	return rc;
+}
+
+/**
+ * Deallocates a result cache.
+ * @param rc: the cache, may be NULL
+ */
+void rc_delete(result_cache* rc)
+{
+	if (rc == NULL)
+		return;
+	free(rc->entries);
+	free(rc->buckets);
+	free(rc);
+}
+
+/**
+ * Removes every decision from the cache. The counters are kept.
+ * @param rc: the cache
+ */
+void rc_clear(result_cache* rc)
+{
+	memset(rc->buckets, -1, sizeof(int) * rc->num_buckets);
+	rc->count = 0;
+	rc->newest = -1;
+	rc->oldest = -1;
+}
+
+/**
+ * Empties the cache when the search settings have changed since it was
+ * filled, since its decisions may no longer be the ones a search returns.
+ */
+static void check_epoch(result_cache* rc)
+{
+	unsigned long epoch = get_search_epoch();
+	if (epoch == rc->epoch)
+		return;
+	if (rc->count > 0)
+		rc->invalidations++;
+	rc_clear(rc);
+	rc->epoch = epoch;
+}
+
+/**
+ * Returns the bucket of a position, player and pair of limits.
+ */
+static int bucket_of(result_cache* rc, uint64_t key, int player, int depth, long ms)
+{
+	uint64_t h = key ^ ((uint64_t) player << 62) ^ ((uint64_t) depth << 40) ^ (uint64_t) ms;
+	return (h * 0x9e3779b97f4a7c15ULL) >> 32 & (rc->num_buckets - 1);
+}
+
+/**
+ * Unlinks an entry from the recency list.
+ */
+static void unlink_entry(result_cache* rc, int i)
+{
+	rc_entry* e = &rc->entries[i];
+	if (e->newer >= 0)
+		rc->entries[e->newer].older = e->older;
+	else
+		rc->newest = e->older;
+	if (e->older >= 0)
+		rc->entries[e->older].newer = e->newer;
+	else
+		rc->oldest = e->newer;
+}
+
+/**
+ * Links an entry in at the newest end of the recency list.
+ */
+static void link_newest(result_cache* rc, int i)
+{
+	rc_entry* e = &rc->entries[i];
+	e->newer = -1;
+	e->older = rc->newest;
+	if (rc->newest >= 0)
+		rc->entries[rc->newest].newer = i;
+	rc->newest = i;
+	if (rc->oldest < 0)
+		rc->oldest = i;
+}
+
+/**
+ * Returns the index of the entry for a position, player and limits, or -1.
+ */
+static int find_entry(result_cache* rc, uint64_t key, int player, int depth, long ms)
+{
+	int i = rc->buckets[bucket_of(rc, key, player, depth, ms)];
+	while (i >= 0) {
+		rc_entry* e = &rc->entries[i];
+		if (e->key == key && e->player == player && e->depth_limit == depth && e->time_limit == ms)
+			return i;
+		i = e->chain;
+	}
+	return -1;
+}
+
+/**
+ * Reflects a decision's columns, to or from the canonical orientation.
+ */
+static void mirror_result(rc_result* result, int num_cols)
+{
+	int i;
+	if (result->move >= 0)
+		result->move = mirror_column(num_cols, result->move);
+	for (i = 0; i < result->pv_length; i++) {
+		result->pv[i] = mirror_column(num_cols, result->pv[i]);
+	}
+}
+
+/**
+ * Looks up the decision for a position under the current search limits.
+ * A hit becomes the most recently used entry.
+ * @param rc: the cache
+ * @param b: the position
+ * @param player: the player to move, 1 (maximizing) or 2
+ * @param result: filled in on a hit
+ * @return 1 on a hit, 0 on a miss
+ */
+int rc_lookup(result_cache* rc, board* b, int player, rc_result* result)
+{
+	int mirrored, depth;
+	long ms;
+	check_epoch(rc);
+	get_search_limits(&depth, &ms);
+	uint64_t key = board_canonical_key(b, &mirrored);
+
+	int i = find_entry(rc, key, player, depth, ms);
+	if (i < 0) {
+		rc->misses++;
+		return 0;
+	}
+	rc->hits++;
+	unlink_entry(rc, i);
+	link_newest(rc, i);
+	*result = rc->entries[i].result;
+	if (mirrored)
+		mirror_result(result, b->column_len);
+	return 1;
+}
+
+/**
+ * Keeps the decision for a position under the current search limits. When
+ * the cache is full the least recently used decision makes room.
+ * @param rc: the cache
+ * @param b: the position
+ * @param player: the player to move, 1 (maximizing) or 2
+ * @param result: the decision
+ */
+void rc_store(result_cache* rc, board* b, int player, rc_result* result)
+{
+	int mirrored, depth;
+	long ms;
+	check_epoch(rc);
+	get_search_limits(&depth, &ms);
+	uint64_t key = board_canonical_key(b, &mirrored);
+
+	int i = find_entry(rc, key, player, depth, ms);
+	if (i >= 0) {
+		unlink_entry(rc, i);
+	} else {
+		if (rc->count < rc->capacity) {
+			i = rc->count++;
+		} else {
+			// Evict the oldest entry from its bucket's chain
+			i = rc->oldest;
+			rc_entry* old = &rc->entries[i];
+			int* link = &rc->buckets[bucket_of(rc, old->key, old->player, old->depth_limit, old->time_limit)];
+			while (*link != i)
+				link = &rc->entries[*link].chain;
+			*link = old->chain;
+			unlink_entry(rc, i);
+		}
+		rc_entry* e = &rc->entries[i];
+		int bucket = bucket_of(rc, key, player, depth, ms);
+		e->key = key;
+		e->player = player;
+		e->depth_limit = depth;
+		e->time_limit = ms;
+		e->chain = rc->buckets[bucket];
+		rc->buckets[bucket] = i;
+	}
+
+	rc->entries[i].result = *result;
+	if (mirrored)
+		mirror_result(&rc->entries[i].result, b->column_len);
+	link_newest(rc, i);
+}
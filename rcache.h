@@ -0,0 +1,63 @@
+/*
+ * rcache.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+#ifndef RCACHE_H_
+#define RCACHE_H_
+#include <stdint.h>
+#include "board.h"
+#include "tree.h"
+
+/* A decision: the move, its score and the line that follows it */
+typedef struct rc_result {
+	int move;
+	int score;
+	int depth;              /* depth of the last completed iteration */
+	int pv_length;
+	signed char pv[TASK_STACK];
+} rc_result;
+
+/* One cached decision, keyed by position, player and search limits */
+typedef struct rc_entry {
+	uint64_t key;           /* canonical key of the position */
+	int player;
+	int depth_limit;
+	long time_limit;
+	rc_result result;       /* for the canonical orientation */
+	int newer;              /* recency list neighbours, -1 at the ends */
+	int older;
+	int chain;              /* next entry in the same bucket, -1 at the end */
+} rc_entry;
+
+/*
+ * Least-recently-used cache of decisions in front of max_decision() and
+ * min_decision(). Entries live in one array, reached through a chained hash
+ * table and kept in recency order by a doubly linked list of indices.
+ * A position and its mirror share an entry. The cache empties itself when
+ * get_search_epoch() says the search settings have changed. Not thread safe.
+ */
+typedef struct result_cache {
+	rc_entry* entries;
+	int capacity;
+	int count;
+	int* buckets;
+	int num_buckets;
+	int newest;
+	int oldest;
+	unsigned long epoch;
+	long hits;
+	long misses;
+	long invalidations;
+} result_cache;
+
+result_cache* rc_create(int capacity);
+void rc_delete(result_cache* rc);
+/* Empty the cache, keeping its counters */
+void rc_clear(result_cache* rc);
+/* 1 when the decision for player (1 or 2) to move is cached */
+int rc_lookup(result_cache* rc, board* b, int player, rc_result* result);
+/* Keep a decision, evicting the least recently used one when full */
+void rc_store(result_cache* rc, board* b, int player, rc_result* result);
+
+#endif /* RCACHE_H_ */
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bitboard.h"
+#include "threat.h"
+#include "memory.h"
+#include "solve.h"
+
+void error(char* msg);
+
+/**
+ * Creates a solver for an n x m connect-r board that fits in a bitboard.
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ * @param r: number of checkers in a row needed to win
+ * @param table_bits: log2 of the number of transposition table entries
+ * @return the solver
+ */
+solver* create_solver(int num_rows, int num_cols, int r, int table_bits)
+{
+	solver* s = (solver*) malloc(sizeof(solver));
+	int i;
+	if (s == NULL) { error("Could not allocate memory for solver"); }
+	s->row_len = num_rows;
+	s->column_len = num_cols;
+	s->r = r;
+	s->table_bits = table_bits;
+	s->nodes = 0;
+	s->stop = NULL;
+	s->aborted = 0;
+	// Zeroed as it is touched, so a large table costs nothing up front
+	s->table = (solve_entry*) mem_alloc(sizeof(solve_entry) << table_bits, 1);
+
+	// Centre columns take part in the most lines, so try them first
+	for (i = 0; i < num_cols; i++) {
+		s->order[i] = num_cols / 2 + ((i % 2 == 0) ? i / 2 : -(i + 1) / 2);
+	}
+	return s;
+}
+
+/**
+ * Deallocates a solver.
+ * @param s: the solver
+ */
+void delete_solver(solver* s)
+{
+	if (s == NULL)
+		return;
+	mem_free(s->table, sizeof(solve_entry) << s->table_bits);
+	free(s);
+}
+
+/**
+ * Negamax alpha-beta search. Immediate wins end the search, a position
+ * with two open opponent wins is lost, and moves beneath an opponent's
+ * winning cell or away from a forced block are never tried. Once the stop
+ * flag is seen the search unwinds without storing anything in the table.
+ */
+static int negamax(solver* s, uint64_t p1, uint64_t mask, int moves, int alpha, int beta)
+{
+	int rows = s->row_len, cols = s->column_len;
+	uint64_t own = (moves % 2 == 0) ? p1 : p1 ^ mask;
+	uint64_t opponent = own ^ mask;
+	int i;
+
+	if ((++s->nodes & SOLVE_STOP_MASK) == 0 && s->stop != NULL && *s->stop)
+		s->aborted = 1;
+	if (s->aborted)
+		return SOLVE_DRAW;
+	uint64_t playable = playable_cells(mask, rows, cols);
+	if (playable == 0)
+		return SOLVE_DRAW;
+	if (winning_cells(own, mask, rows, cols, s->r) & playable)
+		return SOLVE_WIN;
+
+	uint64_t threats = winning_cells(opponent, mask, rows, cols, s->r);
+	uint64_t candidates = playable;
+	if (threats & playable) {
+		if ((threats & playable) & ((threats & playable) - 1))
+			return SOLVE_LOSS;
+		candidates = threats & playable;
+	}
+	candidates &= ~(threats >> 1);
+	if (candidates == 0)
+		return SOLVE_LOSS;
+
+	// Table lookup
+	bitboard bb = { p1, mask, rows, cols, s->r, moves };
+	uint64_t key = bitboard_key(&bb);
+	solve_entry* e = &s->table[(key * 0x9e3779b97f4a7c15ULL) >> (64 - s->table_bits)];
+	int alpha0 = alpha;
+	if (e->key == key) {
+		if (e->bound == SOLVE_EXACT)
+			return e->value;
+		if (e->bound == SOLVE_LOWER && e->value > alpha)
+			alpha = e->value;
+		else if (e->bound == SOLVE_UPPER && e->value < beta)
+			beta = e->value;
+		if (alpha >= beta)
+			return e->value;
+	}
+
+	// Order the moves by the number of winning cells they open, centre
+	// columns first among equals
+	uint64_t cells[64];
+	int counts[64], n = 0, j;
+	for (i = 0; i < cols; i++) {
+		uint64_t cell = candidates & column_mask(rows, s->order[i]);
+		if (cell == 0)
+			continue;
+		int count = __builtin_popcountll(winning_cells(own | cell, mask | cell, rows, cols, s->r) & ~(mask | cell));
+		for (j = n; j > 0 && counts[j-1] < count; j--) {
+			cells[j] = cells[j-1];
+			counts[j] = counts[j-1];
+		}
+		cells[j] = cell;
+		counts[j] = count;
+		n++;
+	}
+
+	int best = SOLVE_LOSS - 1;
+	for (i = 0; i < n; i++) {
+		uint64_t child_p1 = (moves % 2 == 0) ? p1 | cells[i] : p1;
+		int value = -negamax(s, child_p1, mask | cells[i], moves + 1, -beta, -alpha);
+		if (s->aborted)
+			return SOLVE_DRAW;
+		if (value > best)
+			best = value;
+		if (best > alpha)
+			alpha = best;
+		if (alpha >= beta)
+			break;
+	}
+
+	e->key = key;
+	e->value = best;
+	e->bound = (best <= alpha0) ? SOLVE_UPPER : (best >= beta) ? SOLVE_LOWER : SOLVE_EXACT;
+	return best;
+}
+
+/**
+ * Solves a position. A value outside the window is a bound: a result
+ * <= alpha means the value is at most alpha, >= beta at least beta.
+ * @param s: the solver
+ * @param bb: the position, player 1 having moved first
+ * @param alpha: lower end of the window, SOLVE_LOSS for the exact value
+ * @param beta: upper end of the window, SOLVE_WIN for the exact value
+ * @return SOLVE_WIN, SOLVE_DRAW or SOLVE_LOSS for the player to move; check
+ * s->aborted when a stop flag is set
+ */
+int solve_position(solver* s, bitboard* bb, int alpha, int beta)
+{
+	s->aborted = 0;
+	return negamax(s, bb->p1, bb->mask, bb->moves, alpha, beta);
+}
+
+/**
+ * Solves a position given by its key, see solve_position().
+ * @param s: the solver
+ * @param key: the position's key or canonical key
+ * @param alpha: lower end of the window
+ * @param beta: upper end of the window
+ */
+int solve_key(solver* s, uint64_t key, int alpha, int beta)
+{
+	bitboard bb;
+	bitboard_from_key(key, s->row_len, s->column_len, s->r, &bb);
+	return solve_position(s, &bb, alpha, beta);
+}
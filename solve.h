@@ -0,0 +1,57 @@
+/*
+ * solve.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+#ifndef SOLVE_H_
+#define SOLVE_H_
+#include <stdint.h>
+#include <signal.h>
+#include "bitboard.h"
+
+/* Game-theoretic values, for the player to move */
+#define SOLVE_LOSS -1
+#define SOLVE_DRAW 0
+#define SOLVE_WIN 1
+
+/* log2 of the number of table entries (16 MB) */
+#define SOLVE_TABLE_BITS 20
+/* Nodes between checks of the solver's stop flag, minus one */
+#define SOLVE_STOP_MASK 0xfff
+
+/* Bounds stored in the table */
+#define SOLVE_EXACT 0
+#define SOLVE_LOWER 1
+#define SOLVE_UPPER 2
+
+typedef struct solve_entry {
+	uint64_t key;
+	int8_t value;
+	uint8_t bound;
+} solve_entry;
+
+/*
+ * Exact alpha-beta solver over win/draw/loss values. Positions that fit in
+ * a bitboard only; player 1 moves first.
+ */
+typedef struct solver {
+	int row_len;
+	int column_len;
+	int r;
+	int order[64];          /* columns, centre first */
+	solve_entry* table;
+	int table_bits;
+	long nodes;
+	volatile sig_atomic_t* stop;  /* abandons the search once set, or NULL */
+	int aborted;            /* the last search was abandoned */
+} solver;
+
+solver* create_solver(int num_rows, int num_cols, int r, int table_bits);
+void delete_solver(solver* s);
+/* Value of the position for the player to move, within [alpha, beta];
+ * meaningless when the search was abandoned through stop */
+int solve_position(solver* s, bitboard* bb, int alpha, int beta);
+/* Value of a position given by its key */
+int solve_key(solver* s, uint64_t key, int alpha, int beta);
+
+#endif /* SOLVE_H_ */
@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bitboard.h"
+#include "tablebase.h"
+
+/**
+ * Checks that the layer table and every layer's block index, deltas and
+ * values lie inside the file, in that order, so probes never read past
+ * its end. Block offsets into the deltas are checked as they are used.
+ */
+static int layers_fit(const unsigned char* data, size_t length)
+{
+	const tb_header* header = (const tb_header*) data;
+	const tb_layer* layers = (const tb_layer*) (data + sizeof(tb_header));
+	uint32_t l;
+
+	if (header->num_layers > (length - sizeof(tb_header)) / sizeof(tb_layer))
+		return 0;
+	uint64_t start = sizeof(tb_header) + (uint64_t) header->num_layers * sizeof(tb_layer);
+	for (l = 0; l < header->num_layers; l++) {
+		const tb_layer* layer = &layers[l];
+		if (layer->count == 0)
+			continue;
+		if (layer->count > length * 4)
+			return 0;
+		uint64_t num_blocks = (layer->count + TB_BLOCK - 1) / TB_BLOCK;
+		if (layer->blocks < start || layer->blocks % 8 != 0 || layer->blocks > length ||
+				num_blocks > (length - layer->blocks) / sizeof(tb_block) ||
+				layer->deltas < layer->blocks + num_blocks * sizeof(tb_block) ||
+				layer->values < layer->deltas || layer->values > length ||
+				(layer->count + 3) / 4 > length - layer->values)
+			return 0;
+	}
+	return 1;
+}
+
+/**
+ * Memory-maps a tablebase file read-only.
+ * @param path: the file to open
+ * @return the tablebase, or NULL if it could not be opened, is not one, or
+ * is cut short
+ */
+tablebase* tb_open(const char* path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(tb_header)) {
+		close(fd);
+		return NULL;
+	}
+
+	void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return NULL;
+
+	const tb_header* header = (const tb_header*) data;
+	if (memcmp(header->magic, TB_MAGIC, 4) != 0 || header->version != TB_VERSION ||
+			!layers_fit(data, st.st_size)) {
+		munmap(data, st.st_size);
+		return NULL;
+	}
+
+	tablebase* tb = malloc(sizeof(tablebase));
+	tb->data = data;
+	tb->length = st.st_size;
+	tb->header = header;
+	tb->layers = (const tb_layer*) (tb->data + sizeof(tb_header));
+	return tb;
+}
+
+/**
+ * Unmaps and deallocates a tablebase.
+ * @param tb: the tablebase to close
+ */
+void tb_close(tablebase* tb)
+{
+	if (tb == NULL)
+		return;
+	munmap((void*) tb->data, tb->length);
+	free(tb);
+}
+
+/**
+ * Decodes one LEB128 varint and advances the pointer past it.
+ * @return 0 when the varint runs past end or past 64 bits, 1 otherwise
+ */
+static int read_varint(const unsigned char** p, const unsigned char* end, uint64_t* value)
+{
+	int shift = 0;
+	*value = 0;
+	while (*p < end && shift < 64) {
+		unsigned char byte = *(*p)++;
+		*value |= (uint64_t) (byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return 1;
+		shift += 7;
+	}
+	return 0;
+}
+
+/**
+ * Looks up a position. The layer is picked by the number of checkers, the
+ * block by binary search over the block index, and the key by decoding the
+ * block's deltas.
+ * @param tb: the tablebase
+ * @param bb: the position
+ * @return TB_WIN, TB_DRAW or TB_LOSS for the player to move, or TB_UNKNOWN
+ */
+int tb_probe(tablebase* tb, bitboard* bb)
+{
+	const tb_header* header = tb->header;
+	if (bb->row_len != header->row_len || bb->column_len != header->column_len ||
+			bb->r != header->r || bb->moves >= header->num_layers) {
+		return TB_UNKNOWN;
+	}
+
+	const tb_layer* layer = &tb->layers[bb->moves];
+	if (layer->count == 0)
+		return TB_UNKNOWN;
+
+	uint64_t key = bitboard_canonical_key(bb, NULL);
+	const tb_block* blocks = (const tb_block*) (tb->data + layer->blocks);
+	uint64_t num_blocks = (layer->count + TB_BLOCK - 1) / TB_BLOCK;
+
+	// Last block whose first key is <= key
+	uint64_t lo = 0, hi = num_blocks;
+	while (hi - lo > 1) {
+		uint64_t mid = (lo + hi) / 2;
+		if (blocks[mid].first_key <= key)
+			lo = mid;
+		else
+			hi = mid;
+	}
+	if (blocks[lo].first_key > key)
+		return TB_UNKNOWN;
+
+	const unsigned char* deltas_end = tb->data + layer->values;
+	if (blocks[lo].offset > layer->values - layer->deltas)
+		return TB_UNKNOWN;
+	const unsigned char* p = tb->data + layer->deltas + blocks[lo].offset;
+	uint64_t index = lo * TB_BLOCK;
+	uint64_t end = index + TB_BLOCK;
+	uint64_t current = blocks[lo].first_key;
+	if (end > layer->count)
+		end = layer->count;
+
+	while (current < key && ++index < end) {
+		uint64_t delta;
+		if (!read_varint(&p, deltas_end, &delta))
+			return TB_UNKNOWN;
+		current += delta;
+	}
+	if (current != key || index >= end)
+		return TB_UNKNOWN;
+
+	const unsigned char* values = tb->data + layer->values;
+	return (values[index >> 2] >> ((index & 3) << 1)) & 3;
+}
+
+/**
+ * Appends a LEB128 varint to the buffer, growing it as needed.
+ */
+static void write_varint(unsigned char** buf, uint64_t* len, uint64_t* cap, uint64_t value)
+{
+	if (*len + 10 > *cap) {
+		*cap = (*cap + 10) * 2;
+		*buf = realloc(*buf, *cap);
+	}
+	while (value >= 0x80) {
+		(*buf)[(*len)++] = (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+	(*buf)[(*len)++] = value;
+}
+
+/**
+ * Writes a tablebase file.
+ * @param path: the file to write
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ * @param r: number of checkers in a row needed to win
+ * @param keys: per layer, the sorted canonical keys
+ * @param values: per layer, one TB_* value per key
+ * @param counts: per layer, the number of keys
+ * @return 0 on success, 1 on failure
+ */
+int tb_write(const char* path, int num_rows, int num_cols, int r,
+		uint64_t** keys, unsigned char** values, uint64_t* counts)
+{
+	FILE* out = fopen(path, "wb");
+	if (out == NULL)
+		return 1;
+
+	int num_layers = num_rows * num_cols + 1;
+	tb_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TB_MAGIC, 4);
+	header.version = TB_VERSION;
+	header.row_len = num_rows;
+	header.column_len = num_cols;
+	header.r = r;
+	header.num_layers = num_layers;
+
+	tb_layer* layers = calloc(num_layers, sizeof(tb_layer));
+	fwrite(&header, sizeof(header), 1, out);
+	fwrite(layers, sizeof(tb_layer), num_layers, out);
+	uint64_t offset = sizeof(header) + sizeof(tb_layer) * num_layers;
+
+	int l;
+	for (l = 0; l < num_layers; l++) {
+		uint64_t count = counts[l], i;
+		uint64_t num_blocks = (count + TB_BLOCK - 1) / TB_BLOCK;
+		tb_block* blocks = malloc(sizeof(tb_block) * (num_blocks + 1));
+		unsigned char* deltas = NULL;
+		uint64_t len = 0, cap = 0;
+
+		for (i = 0; i < count; i++) {
+			if (i % TB_BLOCK == 0) {
+				blocks[i / TB_BLOCK].first_key = keys[l][i];
+				blocks[i / TB_BLOCK].offset = len;
+			} else {
+				write_varint(&deltas, &len, &cap, keys[l][i] - keys[l][i-1]);
+			}
+		}
+
+		uint64_t value_bytes = (count + 3) / 4;
+		unsigned char* packed = calloc(value_bytes + 1, 1);
+		for (i = 0; i < count; i++) {
+			packed[i >> 2] |= values[l][i] << ((i & 3) << 1);
+		}
+
+		layers[l].count = count;
+		layers[l].blocks = offset;
+		fwrite(blocks, sizeof(tb_block), num_blocks, out);
+		offset += sizeof(tb_block) * num_blocks;
+		layers[l].deltas = offset;
+		fwrite(deltas, 1, len, out);
+		offset += len;
+		layers[l].values = offset;
+		fwrite(packed, 1, value_bytes, out);
+		offset += value_bytes;
+
+		// Keep the next block index 8-byte aligned
+		while (offset % 8 != 0) {
+			fputc(0, out);
+			offset++;
+		}
+
+		free(blocks);
+		free(deltas);
+		free(packed);
+	}
+
+	// Rewrite the layer table now that the offsets are known
+	fseek(out, sizeof(header), SEEK_SET);
+	fwrite(layers, sizeof(tb_layer), num_layers, out);
+	free(layers);
+	return (fclose(out) == 0) ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+/*
+ * tablebase.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+#ifndef TABLEBASE_H_
+#define TABLEBASE_H_
+#include <stdint.h>
+#include <stddef.h>
+#include "bitboard.h"
+
+/* Values, for the player to move */
+#define TB_UNKNOWN 0
+#define TB_LOSS 1
+#define TB_DRAW 2
+#define TB_WIN 3
+
+#define TB_MAGIC "C4TB"
+#define TB_VERSION 1
+/* Keys per delta-coded block */
+#define TB_BLOCK 64
+
+/*
+ * File layout: header, one tb_layer per ply, then per layer a block index
+ * (first key and delta offset of every TB_BLOCK keys), the LEB128 deltas
+ * between consecutive sorted canonical keys, and 2-bit values.
+ */
+typedef struct tb_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t row_len;
+	uint32_t column_len;
+	uint32_t r;
+	uint32_t num_layers;
+} tb_header;
+
+typedef struct tb_layer {
+	uint64_t count;
+	uint64_t blocks;
+	uint64_t deltas;
+	uint64_t values;
+} tb_layer;
+
+typedef struct tb_block {
+	uint64_t first_key;
+	uint64_t offset;
+} tb_block;
+
+typedef struct tablebase {
+	const unsigned char* data;
+	size_t length;
+	const tb_header* header;
+	const tb_layer* layers;
+} tablebase;
+
+/*
+ * Reader functions
+ */
+tablebase* tb_open(const char* path);
+void tb_close(tablebase* tb);
+/* Value of the position for the player to move, TB_UNKNOWN if absent */
+int tb_probe(tablebase* tb, bitboard* bb);
+
+/*
+ * Writer functions
+ */
+/* Write sorted canonical keys and one value byte per key, per layer */
+int tb_write(const char* path, int num_rows, int num_cols, int r,
+		uint64_t** keys, unsigned char** values, uint64_t* counts);
+
+#endif /* TABLEBASE_H_ */
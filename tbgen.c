@@ -0,0 +1,284 @@
+/*
+ * tbgen.c
+ *
+ * Offline retrograde analysis: enumerates every reachable position of an
+ * n x m connect-r board ply by ply, then assigns exact win/draw/loss values
+ * from the last ply back to the empty board and writes a tablebase.
+ * Threads are set with OMP_NUM_THREADS.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "bitboard.h"
+#include "threat.h"
+#include "tablebase.h"
+
+void error(char* msg);
+
+static int compare_keys(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Sorts keys and removes duplicates. Each thread sorts a slice, then the
+ * slices are merged.
+ * @param keys: the keys, replaced by the sorted unique keys
+ * @param count: number of keys, updated to the number kept
+ */
+static void sort_unique(uint64_t** keys, uint64_t* count)
+{
+	int num_threads = omp_get_max_threads();
+	uint64_t n = *count;
+	uint64_t* start = malloc(sizeof(uint64_t) * (num_threads + 1));
+	uint64_t* head = malloc(sizeof(uint64_t) * num_threads);
+	int t;
+
+	for (t = 0; t <= num_threads; t++) {
+		start[t] = n * t / num_threads;
+	}
+
+	#pragma omp parallel for schedule(static, 1)
+	for (t = 0; t < num_threads; t++) {
+		qsort(*keys + start[t], start[t+1] - start[t], sizeof(uint64_t), compare_keys);
+	}
+
+	uint64_t* sorted = malloc(sizeof(uint64_t) * (n + 1));
+	uint64_t kept = 0;
+	for (t = 0; t < num_threads; t++) {
+		head[t] = start[t];
+	}
+	while (1) {
+		int best = -1;
+		for (t = 0; t < num_threads; t++) {
+			if (head[t] < start[t+1] && (best < 0 || (*keys)[head[t]] < (*keys)[head[best]]))
+				best = t;
+		}
+		if (best < 0)
+			break;
+		uint64_t key = (*keys)[head[best]++];
+		if (kept == 0 || sorted[kept-1] != key)
+			sorted[kept++] = key;
+	}
+
+	free(*keys);
+	free(start);
+	free(head);
+	*keys = sorted;
+	*count = kept;
+}
+
+/**
+ * Returns the stones of the player to move.
+ */
+static uint64_t to_move(bitboard* bb)
+{
+	return (bb->moves % 2 == 0) ? bb->p1 : bb->p1 ^ bb->mask;
+}
+
+/**
+ * Plays the checker at cell for the player to move.
+ */
+static void play_cell(bitboard* bb, uint64_t cell)
+{
+	if (bb->moves % 2 == 0)
+		bb->p1 |= cell;
+	bb->mask |= cell;
+	bb->moves++;
+}
+
+/**
+ * Generates the next ply: the canonical keys of every child of every
+ * position in the layer, excluding children in which the mover has won.
+ * @return the number of keys written to *next
+ */
+static uint64_t expand_layer(uint64_t* keys, uint64_t count, uint64_t** next,
+		int num_rows, int num_cols, int r)
+{
+	int num_threads = omp_get_max_threads();
+	uint64_t** local = calloc(num_threads, sizeof(uint64_t*));
+	uint64_t* local_count = calloc(num_threads, sizeof(uint64_t));
+	uint64_t total = 0;
+	int t;
+
+	#pragma omp parallel
+	{
+		int id = omp_get_thread_num();
+		uint64_t cap = 1024, len = 0;
+		uint64_t* out = malloc(sizeof(uint64_t) * cap);
+		uint64_t i;
+
+		#pragma omp for schedule(dynamic, 4096)
+		for (i = 0; i < count; i++) {
+			bitboard bb;
+			bitboard_from_key(keys[i], num_rows, num_cols, r, &bb);
+			uint64_t playable = playable_cells(bb.mask, num_rows, num_cols);
+			uint64_t wins = winning_cells(to_move(&bb), bb.mask, num_rows, num_cols, r);
+			uint64_t moves = playable & ~wins;
+
+			while (moves) {
+				uint64_t cell = moves & -moves;
+				bitboard child = bb;
+				play_cell(&child, cell);
+				if (len == cap) {
+					cap *= 2;
+					out = realloc(out, sizeof(uint64_t) * cap);
+				}
+				out[len++] = bitboard_canonical_key(&child, NULL);
+				moves ^= cell;
+			}
+		}
+		local[id] = out;
+		local_count[id] = len;
+	}
+
+	for (t = 0; t < num_threads; t++) {
+		total += local_count[t];
+	}
+	*next = malloc(sizeof(uint64_t) * (total + 1));
+	total = 0;
+	for (t = 0; t < num_threads; t++) {
+		memcpy(*next + total, local[t], sizeof(uint64_t) * local_count[t]);
+		total += local_count[t];
+		free(local[t]);
+	}
+	free(local);
+	free(local_count);
+
+	sort_unique(next, &total);
+	return total;
+}
+
+/**
+ * Returns the index of key in the sorted keys, or -1.
+ */
+static int64_t find_key(uint64_t* keys, uint64_t count, uint64_t key)
+{
+	uint64_t lo = 0, hi = count;
+	while (lo < hi) {
+		uint64_t mid = (lo + hi) / 2;
+		if (keys[mid] < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (lo < count && keys[lo] == key) ? (int64_t) lo : -1;
+}
+
+/**
+ * Assigns values to a layer from the values of the next one. A position
+ * is a win when it has a winning move, a draw when the board is full, and
+ * otherwise the best of its children's values with the sides swapped.
+ */
+static void evaluate_layer(uint64_t* keys, unsigned char* values, uint64_t count,
+		uint64_t* next_keys, unsigned char* next_values, uint64_t next_count,
+		int num_rows, int num_cols, int r)
+{
+	uint64_t i;
+
+	#pragma omp parallel for schedule(dynamic, 4096)
+	for (i = 0; i < count; i++) {
+		bitboard bb;
+		bitboard_from_key(keys[i], num_rows, num_cols, r, &bb);
+		uint64_t playable = playable_cells(bb.mask, num_rows, num_cols);
+		uint64_t wins = winning_cells(to_move(&bb), bb.mask, num_rows, num_cols, r);
+
+		if (playable & wins) {
+			values[i] = TB_WIN;
+			continue;
+		} else if (playable == 0) {
+			values[i] = TB_DRAW;
+			continue;
+		}
+
+		int best = TB_LOSS;
+		uint64_t moves = playable;
+		while (moves && best != TB_WIN) {
+			uint64_t cell = moves & -moves;
+			bitboard child = bb;
+			play_cell(&child, cell);
+			int64_t index = find_key(next_keys, next_count, bitboard_canonical_key(&child, NULL));
+			if (index < 0) {
+				error("tbgen: child position missing from next ply");
+			}
+			// A loss for the opponent is a win for the mover
+			int value = TB_WIN + TB_LOSS - next_values[index];
+			if (value > best)
+				best = value;
+			moves ^= cell;
+		}
+		values[i] = best;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc != 5) { error("usage -- ./tbgen n m r file"); }
+
+	int num_rows = strtol(argv[1], NULL, 10);
+	int num_cols = strtol(argv[2], NULL, 10);
+	int r = strtol(argv[3], NULL, 10);
+	if (num_rows < 1 || num_cols < 1 || r < 1) { error("tbgen: invalid board"); }
+	if (!bitboard_fits(num_rows, num_cols)) { error("tbgen: board must satisfy (n + 1) * m <= 64"); }
+
+	int num_layers = num_rows * num_cols + 1;
+	uint64_t** keys = calloc(num_layers, sizeof(uint64_t*));
+	unsigned char** values = calloc(num_layers, sizeof(unsigned char*));
+	uint64_t* counts = calloc(num_layers, sizeof(uint64_t));
+	uint64_t total = 0;
+	int l;
+
+	// Forward pass: reachable positions, ply by ply
+	bitboard empty;
+	memset(&empty, 0, sizeof(empty));
+	empty.row_len = num_rows;
+	empty.column_len = num_cols;
+	empty.r = r;
+	keys[0] = malloc(sizeof(uint64_t));
+	keys[0][0] = bitboard_canonical_key(&empty, NULL);
+	counts[0] = 1;
+	for (l = 0; l + 1 < num_layers; l++) {
+		counts[l+1] = expand_layer(keys[l], counts[l], &keys[l+1], num_rows, num_cols, r);
+		total += counts[l];
+		printf("ply %2d: %llu positions\n", l, (unsigned long long) counts[l]);
+		fflush(stdout);
+	}
+	total += counts[num_layers-1];
+	printf("ply %2d: %llu positions\n", num_layers - 1, (unsigned long long) counts[num_layers-1]);
+
+	// Backward pass: values from the last ply up
+	for (l = num_layers - 1; l >= 0; l--) {
+		values[l] = malloc(counts[l] + 1);
+		if (l == num_layers - 1) {
+			evaluate_layer(keys[l], values[l], counts[l], NULL, NULL, 0, num_rows, num_cols, r);
+		} else {
+			evaluate_layer(keys[l], values[l], counts[l], keys[l+1], values[l+1], counts[l+1],
+					num_rows, num_cols, r);
+		}
+	}
+
+	const char* names[4] = { "unknown", "loss", "draw", "win" };
+	printf("%llu positions, empty board is a %s for the first player\n",
+			(unsigned long long) total, names[values[0][0]]);
+
+	if (tb_write(argv[4], num_rows, num_cols, r, keys, values, counts) != 0) {
+		error("tbgen: could not write tablebase");
+	}
+
+	for (l = 0; l < num_layers; l++) {
+		free(keys[l]);
+		free(values[l]);
+	}
+	free(keys);
+	free(values);
+	free(counts);
+	return 0;
+}
+
+void error(char* msg)
+{
+	printf("%s\n", msg);
+	exit(1);
+}
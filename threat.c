@@ -0,0 +1,146 @@
+#include <stdint.h>
+#include "bitboard.h"
+#include "threat.h"
+
+/**
+ * Returns the mask of every cell on the board (sentinel bits excluded).
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ */
+static uint64_t board_mask(int num_rows, int num_cols)
+{
+	return bottom_mask(num_rows, num_cols) * (((uint64_t) 1 << num_rows) - 1);
+}
+
+/**
+ * Shifts x by n bits in either direction, clearing it when the shift is
+ * wider than the word.
+ */
+static uint64_t shift(uint64_t x, int n)
+{
+	if (n >= 64 || n <= -64)
+		return 0;
+	return (n >= 0) ? x << n : x >> -n;
+}
+
+/**
+ * Returns the empty cells that would complete r checkers in a row for the
+ * given stones. For every direction, a cell wins when k stones lie
+ * directly behind it and r-1-k directly ahead of it for some k. The empty
+ * sentinel bit above each column stops lines wrapping between columns.
+ * @param stones: the player's checkers
+ * @param mask: all occupied cells
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ * @param r: number of checkers in a row needed to win
+ */
+uint64_t winning_cells(uint64_t stones, uint64_t mask, int num_rows, int num_cols, int r)
+{
+	int h = num_rows + 1;
+	int dirs[4] = { 1, h, h - 1, h + 1 };
+	uint64_t result = 0;
+	uint64_t behind[65], ahead[65];
+	int d, k;
+
+	if (r > 64)
+		return 0;
+	for (d = 0; d < 4; d++) {
+		behind[0] = ~(uint64_t) 0;
+		ahead[0] = ~(uint64_t) 0;
+		for (k = 1; k < r; k++) {
+			behind[k] = behind[k-1] & shift(stones, k * dirs[d]);
+			ahead[k] = ahead[k-1] & shift(stones, -k * dirs[d]);
+		}
+		for (k = 0; k < r; k++) {
+			result |= behind[k] & ahead[r-1-k];
+		}
+	}
+	return result & board_mask(num_rows, num_cols) & ~mask;
+}
+
+/**
+ * Returns the lowest empty cell of every column that is not full.
+ * @param mask: all occupied cells
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ */
+uint64_t playable_cells(uint64_t mask, int num_rows, int num_cols)
+{
+	return (mask + bottom_mask(num_rows, num_cols)) & board_mask(num_rows, num_cols);
+}
+
+/**
+ * Returns a bit per column for each column containing one of the cells.
+ * @param cells: the cells
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ */
+unsigned int cell_columns(uint64_t cells, int num_rows, int num_cols)
+{
+	unsigned int columns = 0;
+	int i;
+	for (i = 0; i < num_cols; i++) {
+		if (cells & column_mask(num_rows, i))
+			columns |= 1u << i;
+	}
+	return columns;
+}
+
+/**
+ * Classifies the position for the player to move before it is searched.
+ * An immediate win is THREAT_WIN. Two playable opponent wins (a double
+ * threat) are THREAT_LOSS, as is a single one with another opponent win
+ * stacked directly above it. A single playable opponent win is
+ * THREAT_FORCED and only the blocking column is worth searching. Otherwise
+ * the columns exclude moves that drop directly beneath an opponent's winning
+ * cell; when every move does, the position is THREAT_LOSS.
+ * @param bb: the position
+ * @param player: the player to move, 1 or 2
+ * @param t: the analysis to fill
+ */
+void threat_analyze(bitboard* bb, int player, threats* t)
+{
+	int rows = bb->row_len, cols = bb->column_len;
+	uint64_t p1 = bb->p1, p2 = bb->p1 ^ bb->mask;
+	uint64_t mine = (player == 1) ? p1 : p2;
+	uint64_t theirs = (player == 1) ? p2 : p1;
+
+	t->own = winning_cells(mine, bb->mask, rows, cols, bb->r);
+	t->opponent = winning_cells(theirs, bb->mask, rows, cols, bb->r);
+	t->playable = playable_cells(bb->mask, rows, cols);
+
+	if (t->playable == 0) {
+		t->result = THREAT_NONE;
+		t->columns = 0;
+		return;
+	}
+
+	uint64_t wins = t->own & t->playable;
+	if (wins) {
+		t->result = THREAT_WIN;
+		t->columns = cell_columns(wins, rows, cols);
+		return;
+	}
+
+	uint64_t blocks = t->opponent & t->playable;
+	if (blocks) {
+		// Clearing the lowest bit leaves any second threat
+		if ((blocks & (blocks - 1)) || ((blocks << 1) & t->opponent)) {
+			t->result = THREAT_LOSS;
+			t->columns = cell_columns(t->playable, rows, cols);
+		} else {
+			t->result = THREAT_FORCED;
+			t->columns = cell_columns(blocks, rows, cols);
+		}
+		return;
+	}
+
+	uint64_t safe = t->playable & ~(t->opponent >> 1);
+	if (safe) {
+		t->result = THREAT_NONE;
+		t->columns = cell_columns(safe, rows, cols);
+	} else {
+		t->result = THREAT_LOSS;
+		t->columns = cell_columns(t->playable, rows, cols);
+	}
+}
@@ -0,0 +1,34 @@
+/*
+ * threat.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+#ifndef THREAT_H_
+#define THREAT_H_
+#include <stdint.h>
+#include "bitboard.h"
+
+/* Outcomes for the player to move */
+#define THREAT_NONE 0
+#define THREAT_WIN 1      /* can win this move */
+#define THREAT_LOSS 2     /* every move loses: double or stacked threat */
+#define THREAT_FORCED 3   /* must block the one opponent threat */
+
+typedef struct threats {
+	uint64_t own;         /* empty cells that win for the player to move */
+	uint64_t opponent;    /* empty cells that win for the opponent */
+	uint64_t playable;    /* cells a checker can be dropped into */
+	int result;
+	unsigned int columns; /* bit per column worth searching */
+} threats;
+
+/* Empty cells that would complete r in a row for stones */
+uint64_t winning_cells(uint64_t stones, uint64_t mask, int num_rows, int num_cols, int r);
+/* Cells a checker can be dropped into */
+uint64_t playable_cells(uint64_t mask, int num_rows, int num_cols);
+/* Bit per column for every column holding one of cells */
+unsigned int cell_columns(uint64_t cells, int num_rows, int num_cols);
+/* Analyze the position for player (1 or 2) to move */
+void threat_analyze(bitboard* bb, int player, threats* t);
+
+#endif /* THREAT_H_ */
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "trace.h"
+
+int trace_enabled = 0;
+
+/* Every chunk ever allocated, most recent first */
+static trace_chunk* chunks = NULL;
+static pthread_mutex_t chunks_lock = PTHREAD_MUTEX_INITIALIZER;
+static int next_tid = 0;
+static long num_chunks = 0;
+/* Events that did not fit in TRACE_MAX_EVENTS */
+static long dropped = 0;
+static uint64_t trace_origin;
+static char* trace_path = NULL;
+
+/* The chunk the calling thread is filling */
+static __thread trace_chunk* current = NULL;
+static __thread int current_tid = -1;
+
+/**
+ * Returns the monotonic clock in nanoseconds.
+ */
+uint64_t trace_now()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * Starts recording spans.
+ * @param path: the file the trace is written to on trace_close()
+ * @return 0 on success, 1 if the file cannot be written
+ */
+int trace_open(const char* path)
+{
+	FILE* out = fopen(path, "w");
+	if (out == NULL)
+		return 1;
+	fclose(out);
+
+	trace_path = strdup(path);
+	trace_origin = trace_now();
+	// The opening thread is shown as the main thread
+	current_tid = next_tid++;
+	trace_enabled = 1;
+	return 0;
+}
+
+/**
+ * Gives the calling thread a fresh chunk. Only this takes the lock, once
+ * per TRACE_CHUNK events.
+ * @return the chunk, or NULL once TRACE_MAX_EVENTS are buffered
+ */
+static trace_chunk* new_chunk()
+{
+	pthread_mutex_lock(&chunks_lock);
+	if (num_chunks >= TRACE_MAX_EVENTS / TRACE_CHUNK) {
+		pthread_mutex_unlock(&chunks_lock);
+		return NULL;
+	}
+	num_chunks++;
+	trace_chunk* chunk = malloc(sizeof(trace_chunk));
+	chunk->count = 0;
+	if (current_tid < 0)
+		current_tid = next_tid++;
+	chunk->tid = current_tid;
+	chunk->next = chunks;
+	chunks = chunk;
+	pthread_mutex_unlock(&chunks_lock);
+	return chunk;
+}
+
+/**
+ * Records a span in the calling thread's buffer.
+ * @param name: the span's name, a string that outlives the trace
+ * @param category: the span's category, likewise
+ * @param start: trace_now() at the start of the span
+ * @param arg_name: name of the argument, or NULL
+ * @param arg: the argument's value
+ * @param arg2_name: name of the second argument, or NULL
+ * @param arg2: the second argument's value
+ */
+void trace_record(const char* name, const char* category, uint64_t start, const char* arg_name, long arg,
+		const char* arg2_name, long arg2)
+{
+	uint64_t end = trace_now();
+	if (current == NULL || current->count == TRACE_CHUNK) {
+		trace_chunk* chunk = new_chunk();
+		if (chunk == NULL) {
+			__atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+			return;
+		}
+		current = chunk;
+	}
+
+	trace_event* e = &current->events[current->count++];
+	e->name = name;
+	e->category = category;
+	e->arg_name = arg_name;
+	e->arg = arg;
+	e->arg2_name = arg2_name;
+	e->arg2 = arg2;
+	e->start = start;
+	e->duration = end - start;
+}
+
+/**
+ * Writes every recorded span as Chrome trace JSON, viewable in
+ * chrome://tracing or Perfetto, and frees the buffers. The number of spans
+ * dropped for want of room is written as otherData. Threads must have
+ * stopped recording.
+ */
+void trace_close()
+{
+	if (!trace_enabled)
+		return;
+	trace_enabled = 0;
+
+	FILE* out = fopen(trace_path, "w");
+	trace_chunk* chunk = chunks;
+	int first = 1, tid;
+
+	if (out != NULL) {
+		fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+		for (tid = 0; tid < next_tid; tid++) {
+			fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+					"\"args\":{\"name\":\"%s %d\"}}", first ? "" : ",\n", tid,
+					tid == 0 ? "main" : "worker", tid);
+			first = 0;
+		}
+	}
+	while (chunk != NULL) {
+		trace_chunk* next = chunk->next;
+		int i;
+		for (i = 0; out != NULL && i < chunk->count; i++) {
+			trace_event* e = &chunk->events[i];
+			fprintf(out, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+					"\"ts\":%.3f,\"dur\":%.3f", first ? "" : ",\n", e->name, e->category, chunk->tid,
+					(e->start - trace_origin) / 1000.0, e->duration / 1000.0);
+			if (e->arg2_name != NULL)
+				fprintf(out, ",\"args\":{\"%s\":%ld,\"%s\":%ld}", e->arg_name, e->arg,
+						e->arg2_name, e->arg2);
+			else if (e->arg_name != NULL)
+				fprintf(out, ",\"args\":{\"%s\":%ld}", e->arg_name, e->arg);
+			fprintf(out, "}");
+			first = 0;
+		}
+		free(chunk);
+		chunk = next;
+	}
+	if (out != NULL) {
+		fprintf(out, "\n],\"otherData\":{\"dropped_events\":%ld}}\n", dropped);
+		fclose(out);
+	}
+	if (dropped > 0)
+		printf("Trace buffer full, %ld events dropped\n", dropped);
+
+	chunks = NULL;
+	num_chunks = 0;
+	dropped = 0;
+	current = NULL;
+	free(trace_path);
+	trace_path = NULL;
+}
@@ -0,0 +1,76 @@
+/*
+ * trace.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+#ifndef TRACE_H_
+#define TRACE_H_
+#include <stdint.h>
+
+/* Events per buffer chunk; each thread fills its own chunks */
+#define TRACE_CHUNK 4096
+/* Most events kept across all threads; later ones are counted and dropped */
+#define TRACE_MAX_EVENTS (1 << 21)
+
+/* A completed span ("X" event in the Chrome trace format) */
+typedef struct trace_event {
+	const char* name;
+	const char* category;
+	const char* arg_name;   /* NULL when the event has no argument */
+	long arg;
+	const char* arg2_name;  /* NULL when the event has no second argument */
+	long arg2;
+	uint64_t start;         /* ns */
+	uint64_t duration;      /* ns */
+} trace_event;
+
+typedef struct trace_chunk {
+	int tid;
+	int count;
+	struct trace_chunk* next;
+	trace_event events[TRACE_CHUNK];
+} trace_chunk;
+
+/* Non-zero between trace_open() and trace_close() */
+extern int trace_enabled;
+
+/* Start recording; the trace is written to path by trace_close() */
+int trace_open(const char* path);
+/* Write the recorded events as Chrome trace JSON and stop recording */
+void trace_close();
+/* Monotonic time in ns */
+uint64_t trace_now();
+/* Record a span that started at start and ends now */
+void trace_record(const char* name, const char* category, uint64_t start, const char* arg_name, long arg,
+		const char* arg2_name, long arg2);
+
+/* Start of a span, or 0 when tracing is off */
+static inline uint64_t trace_begin()
+{
+	return trace_enabled ? trace_now() : 0;
+}
+
+/* End a span started with trace_begin(); name and category must be literals */
+static inline void trace_end(const char* name, const char* category, uint64_t start)
+{
+	if (trace_enabled)
+		trace_record(name, category, start, NULL, 0, NULL, 0);
+}
+
+/* As trace_end(), with one integer argument shown in the viewer */
+static inline void trace_end_arg(const char* name, const char* category, uint64_t start,
+		const char* arg_name, long arg)
+{
+	if (trace_enabled)
+		trace_record(name, category, start, arg_name, arg, NULL, 0);
+}
+
+/* As trace_end(), with two integer arguments */
+static inline void trace_end_args(const char* name, const char* category, uint64_t start,
+		const char* arg_name, long arg, const char* arg2_name, long arg2)
+{
+	if (trace_enabled)
+		trace_record(name, category, start, arg_name, arg, arg2_name, arg2);
+}
+
+#endif /* TRACE_H_ */
@@ -1,9 +1,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <omp.h>
 #include "linked_list.h"
 #include "board.h"
+#include "bitboard.h"
+#include "threat.h"
+#include "tablebase.h"
+#include "ttable.h"
+#include "eval.h"
+#include "nnue.h"
+#include "trace.h"
+#include "perf.h"
 #include "tree.h"
 
 /**
@@ -14,7 +23,6 @@ tree* create_tree()
 {
   tree* t = (tree*) malloc(sizeof(tree));
   t -> root = NULL;
-  t -> search_order = (struct list*) create_list();
   return t;
 }
 
@@ -26,14 +34,13 @@ void delete_tree(tree* tree)
 {
 	struct list_node* root = (struct list_node*) tree -> root;
 	delete_node(root);
-	free(tree->search_order);
 	free(tree);
 }
 
 /**
  * This function sets the root for the specified tree
  * @param tree: the tree whose root is to be set
- * @param board: the game board to assign to the tree's root
+ * @param board: the game board to copy into the tree's root
  */
 void set_root(tree* tree, struct board* board)
 {
@@ -53,28 +60,108 @@ void set_root(tree* tree, struct board* board)
 void delete_permutations(tree** game_tree, board** b)
 {
 	delete_list((*game_tree) -> root -> children);
-	(*game_tree) -> root -> children = create_list();
+	(*game_tree) -> root -> children = NULL;
+}
+
+/* Plies generated and searched, see set_search_depth() */
+static int search_depth = SEARCH_DEPTH;
+/* Forced moves searched without using up a ply, see set_extensions() */
+static int search_extensions = 1;
+/* Changed by every setting that changes what a search returns, other than
+ * its depth and time limits, see get_search_epoch() */
+static unsigned long search_epoch = 0;
+
+/* Share children between nodes holding the same position */
+static int share_transpositions = 0;
+
+/* Nodes that have children, by position, while a tree is generated */
+typedef struct position_entry {
+	uint64_t key;
+	struct list_node* owner;
+} position_entry;
+
+static position_entry* positions = NULL;
+static long positions_size = 0;
+static long positions_count = 0;
+
+/**
+ * This function makes generate_permutations() build a DAG: a position
+ * reached by several move orders gets one block of children, shared by
+ * every node holding it. Positions with equal numbers of checkers are at
+ * the same ply, so the shared subtree has the right depth everywhere.
+ * @param enabled: 1 to share, 0 to give every node its own children
+ */
+void set_transpositions(int enabled)
+{
+	share_transpositions = enabled;
+	search_epoch++;
+}
+
+/**
+ * This function finds the slot for a position in the table: the one
+ * holding it, or the empty slot where it belongs.
+ */
+static position_entry* find_position(uint64_t key, board* b)
+{
+	long i = (key * 0x9e3779b97f4a7c15ULL) & (positions_size - 1);
+	while (positions[i].owner != NULL &&
+			(positions[i].key != key || compare_board(&positions[i].owner -> value, b) != 0))
+		i = (i + 1) & (positions_size - 1);
+	return &positions[i];
+}
+
+/**
+ * This function records a node whose children have been generated,
+ * doubling the table when it is half full.
+ */
+static void add_position(uint64_t key, struct list_node* owner)
+{
+	if (2 * (positions_count + 1) > positions_size) {
+		position_entry* old = positions;
+		long old_size = positions_size, i;
+		positions_size = (old_size == 0) ? 1024 : old_size * 2;
+		positions = (position_entry*) calloc(positions_size, sizeof(position_entry));
+		if (positions == NULL) { error("Could not allocate memory for position table"); }
+		for (i = 0; i < old_size; i++) {
+			if (old[i].owner != NULL)
+				*find_position(old[i].key, &old[i].owner -> value) = old[i];
+		}
+		free(old);
+	}
+	position_entry* e = find_position(key, &owner -> value);
+	e -> key = key;
+	e -> owner = owner;
+	positions_count++;
 }
 
 /**
  * This function generates the nth permutation of the current game state. It
  * enumerates each possible move for the parent board, appends those child
  * boards to the parent board, and recursively calls itself until the recursion
- * limit is reached.
+ * limit is reached. Only one of each pair of mirrored moves is enumerated
+ * from a symmetric board. All children of a board are created before any of
+ * them is expanded, so they sit next to each other in memory. With
+ * transpositions shared, a board already expanded elsewhere in the tree
+ * takes that board's children instead of generating its own.
+ * Boards that fit in a bitboard carry one down the recursion for the threat
+ * analysis the search runs on every node: won and lost boards get no
+ * children, since the search scores them without any, and only the moves
+ * the analysis leaves are enumerated. A board left with a single move is
+ * extended: its child does not use up a ply, see FORCED_EXTENSIONS.
  * @param parent: the list node to be appended to
  * @param b: the game state belonging to the parent node
  * @param nth_perm: the current permutation being generated
  * @param player: the player for whom moves are to be enumerated
+ * @param bb: the parent's bitboard, or NULL when the board does not fit
+ * @param extensions: forced moves extended on the way to the parent
  */
-void generate_permutations(struct list_node** parent, board* b, int nth_perm, int player)
+static void expand_permutations(struct list_node** parent, board* b, int nth_perm, int player,
+		bitboard* bb, int extensions)
 {
-	// Check recursion depth
-	if (nth_perm == 6) { return; }
-	nth_perm += 1;
-
-	// Setup loop
-	int num_columns = b -> column_len;
-	int i;
+	int root = (nth_perm == 0);
+	unsigned int allowed = ~0u;
+	int extend = 0;
+	threats t;
 
 	// Swap players
 	if (player == 1)
@@ -82,26 +169,1048 @@ void generate_permutations(struct list_node** parent, board* b, int nth_perm, in
 	else
 		player = 1;
 
-	// Iterate over columns and enumerate game board
+	t.own = 0;
+	if (bb != NULL) {
+		threat_analyze(bb, player, &t);
+		if (!root) {
+			if (t.result == THREAT_WIN || t.result == THREAT_LOSS) { return; }
+			allowed = t.columns;
+			extend = search_extensions && extensions < FORCED_EXTENSIONS &&
+					__builtin_popcount(allowed) == 1;
+		}
+	}
+
+	// Check recursion depth
+	if (nth_perm == search_depth && !extend) { return; }
+	if (extend)
+		extensions++;
+	else
+		nth_perm += 1;
+
+	// A position seen before shares the children already generated for it.
+	// Its remaining depth follows from the extensions taken to reach it.
+	uint64_t key = 0;
+	if (share_transpositions && !root && (*parent) -> children == NULL) {
+		key = board_key(b) ^ extensions;
+		position_entry* e = (positions_size > 0) ? find_position(key, b) : NULL;
+		if (e != NULL && e -> owner != NULL) {
+			if (e -> owner -> children != NULL)
+				share_children(*parent, e -> owner -> children);
+			return;
+		}
+	}
+
+	// Setup loop
+	int num_columns = b -> column_len;
+	int i, num_moves = 0;
+
+	// Moves in mirrored columns of a symmetric board lead to mirrored
+	// subtrees with equal scores, so only enumerate the left half
+	if (board_is_symmetric(b))
+		num_columns = (num_columns + 1) / 2;
+
+	// A move is valid while the column's top cell is empty
 	for (i = 0; i < num_columns; i++) {
-		board* permutation = copy_board(b);
-		// Ensure the move is valid
-		if (add_checker(permutation, i, player) == 1) {
-			delete_board(permutation);
+		if (get_cell(b, i) == 0 && (allowed & (1u << i)))
+			num_moves++;
+	}
+	if (num_moves == 0) { return; }
+
+	// Enumerate every child first so siblings share one contiguous block
+	for (i = 0; i < num_columns; i++) {
+		if (get_cell(b, i) == 0 && (allowed & (1u << i))) {
+			struct list_node* child = add_child(parent, b, num_moves);
+			child -> value.best_score = 0;
+			add_checker(&child -> value, i, player);
+		}
+	}
+
+	// Then recurse into each child whose board is not finished
+	struct list* children = (*parent) -> children;
+	uint64_t playable = (bb != NULL) ? playable_cells(bb -> mask, bb -> row_len, bb -> column_len) : 0;
+	for (i = 0; i < children -> size; i++) {
+		struct list_node* child = &children -> head[i];
+		if (bb != NULL) {
+			bitboard next = *bb;
+			uint64_t cell = playable & column_mask(bb -> row_len, child -> value.move);
+			if (cell & t.own) {
+				// fall through, the move wins
+				continue;
+			}
+			next.mask |= cell;
+			if (player == 1)
+				next.p1 |= cell;
+			next.moves++;
+			expand_permutations(&child, &child -> value, nth_perm, player, &next, extensions);
+		} else if (terminal_test(&child -> value) > 0) {
+			// fall through, don't enumerate finished board
+		} else {
+			expand_permutations(&child, &child -> value, nth_perm, player, NULL, extensions);
+		}
+	}
+
+	if (share_transpositions && !root)
+		add_position(key, *parent);
+}
+
+/**
+ * This function generates the game tree below the parent node to the
+ * search depth, see expand_permutations().
+ * @param parent: the list node to be appended to
+ * @param b: the game state belonging to the parent node
+ * @param nth_perm: the current permutation being generated
+ * @param player: the player for whom moves are to be enumerated
+ */
+void generate_permutations(struct list_node** parent, board* b, int nth_perm, int player)
+{
+	bitboard bb;
+	if (bitboard_fits(b -> row_len, b -> column_len)) {
+		bitboard_encode(b, &bb);
+		expand_permutations(parent, b, nth_perm, player, &bb, 0);
+	} else {
+		expand_permutations(parent, b, nth_perm, player, NULL, 0);
+	}
+
+	// The table is only needed while generating
+	free(positions);
+	positions = NULL;
+	positions_size = 0;
+	positions_count = 0;
+}
+
+/* Nodes visited since the last reset_search_nodes() */
+static long search_nodes = 0;
+/* Tablebase probed before searching, if any */
+static tablebase* search_tablebase = NULL;
+
+/**
+ * This function sets the tablebase consulted by the search.
+ * @param tb: the tablebase, or NULL to search without one
+ */
+void set_tablebase(tablebase* tb)
+{
+	search_tablebase = tb;
+	search_epoch++;
+}
+
+/* Transposition cache shared with other runs, if any */
+static ttable* search_cache = NULL;
+
+/**
+ * This function sets the transposition cache used by the search.
+ * @param tt: the cache, or NULL to search without one
+ */
+void set_cache(ttable* tt)
+{
+	search_cache = tt;
+	search_epoch++;
+}
+
+/* Leaf evaluator, EVAL_HEURISTIC, EVAL_BITBOARD or EVAL_NN */
+static int search_eval = EVAL_HEURISTIC;
+static evaluator search_evaluator;
+static nn_network* search_network = NULL;
+
+/**
+ * This function selects how the search scores its leaves. The bitboard
+ * evaluator needs a board that fits in a bitboard, the network evaluator
+ * a network given to set_network().
+ * @param kind: EVAL_HEURISTIC, EVAL_BITBOARD or EVAL_NN
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ * @param r: number of checkers in a row needed to win
+ */
+void set_evaluator(int kind, int num_rows, int num_cols, int r)
+{
+	search_eval = kind;
+	search_epoch++;
+	if (kind == EVAL_BITBOARD)
+		eval_init(&search_evaluator, num_rows, num_cols, r, WIN_SCORE);
+}
+
+/**
+ * This function sets the network the EVAL_NN evaluator scores leaves with.
+ * @param net: the network, or NULL for none
+ */
+void set_network(nn_network* net)
+{
+	search_network = net;
+	search_epoch++;
+}
+
+/* Late-move reductions, on unless an exact search is wanted */
+static int search_reductions = 1;
+/* Time per decision in milliseconds, 0 for none */
+static long search_time = 0;
+/* Depth of the last completed iteration of the last decision */
+static int search_depth_reached = 0;
+/* Principal variation of the last decision, starting with its move */
+static signed char search_pv[TASK_STACK];
+static int search_pv_length = 0;
+
+/**
+ * This function turns late-move reductions on or off. Reduced moves can be
+ * misjudged at the full depth, so searches that must be exact to the depth
+ * searched turn them off.
+ * @param enabled: 1 to reduce late moves, 0 to search every move fully
+ */
+void set_reductions(int enabled)
+{
+	search_reductions = enabled;
+	search_epoch++;
+}
+
+/**
+ * This function turns forced-move extensions on or off. The tree must be
+ * generated with the setting it is searched with.
+ * @param enabled: 1 to extend forced moves, 0 to count them as plies
+ */
+void set_extensions(int enabled)
+{
+	search_extensions = enabled;
+	search_epoch++;
+}
+
+/**
+ * This function sets the number of plies generated below the root and
+ * searched by the decision functions.
+ * @param depth: plies, at least 1 and at most TASK_STACK - FORCED_EXTENSIONS - 1
+ */
+void set_search_depth(int depth)
+{
+	search_depth = depth;
+}
+
+/**
+ * This function limits the time max_decision() and min_decision() take.
+ * When it runs out they answer with the last completed iteration.
+ * @param ms: milliseconds per decision, 0 for no limit
+ */
+void set_search_time(long ms)
+{
+	search_time = ms;
+}
+
+/**
+ * This function looks the node's position up in the cache. The cache is
+ * keyed by canonical keys, so a move found for the mirrored position is
+ * mirrored back.
+ * @param n: the node
+ * @param maximizing: 1 when the player to move at n is maximizing
+ * @param result: filled in when the position is found
+ * @param t: the search task, whose probe counts are updated
+ * @return 1 when the position was found
+ */
+static int probe_cache(struct list_node* n, int maximizing, tt_result* result, search_task* t)
+{
+	int mirrored;
+	if (search_cache == NULL)
+		return 0;
+	uint64_t key = board_canonical_key(&n -> value, &mirrored);
+	t -> cache_probes++;
+	if (!tt_probe(search_cache, key, maximizing, result))
+		return 0;
+	t -> cache_hits++;
+	if (mirrored && result -> move >= 0)
+		result -> move = mirror_column(n -> value.column_len, result -> move);
+	return 1;
+}
+
+/**
+ * This function stores the result of searching a node in the cache.
+ * @param n: the node
+ * @param maximizing: 1 when the player to move at n is maximizing
+ * @param depth: the depth searched
+ * @param bound: TT_EXACT, TT_LOWER or TT_UPPER
+ * @param score: the node's score
+ * @param move: the best column, or -1
+ */
+static void store_cache(struct list_node* n, int maximizing, int depth, int bound, int score, int move)
+{
+	int mirrored;
+	if (search_cache == NULL)
+		return;
+	uint64_t key = board_canonical_key(&n -> value, &mirrored);
+	if (mirrored && move >= 0)
+		move = mirror_column(n -> value.column_len, move);
+	tt_store(search_cache, key, maximizing, depth, bound, score, move);
+}
+
+/**
+ * This function moves the child playing move to the front of the list,
+ * keeping the order of the others.
+ * @param actions: the children
+ * @param move: the column to try first
+ */
+static void move_to_front(struct list* actions, int move)
+{
+	int i;
+	for (i = 1; i < get_size(actions); i++) {
+		if (actions -> head[i].value.move == move) {
+			node first = actions -> head[i];
+			memmove(&actions -> head[1], &actions -> head[0], sizeof(node) * i);
+			actions -> head[0] = first;
+			return;
+		}
+	}
+}
+
+/**
+ * This function looks the position up in the tablebase.
+ * @param bb: the position
+ * @param player: the player to move, 1 (maximizing) or 2
+ * @param score: set to the position's exact score when found
+ * @param t: the search task, whose probe counts are updated, or NULL
+ * @return 1 when the position was found
+ */
+static int probe_tablebase(bitboard* bb, int player, int* score, search_task* t)
+{
+	// The tablebase assumes player 1 moves first
+	if (search_tablebase == NULL || player != ((bb -> moves % 2 == 0) ? 1 : 2))
+		return 0;
+
+	int value = tb_probe(search_tablebase, bb);
+	if (t != NULL) {
+		t -> tablebase_probes++;
+		t -> tablebase_hits += (value != TB_UNKNOWN);
+	}
+	if (value == TB_UNKNOWN)
+		return 0;
+	if (value == TB_DRAW)
+		*score = 0;
+	else
+		*score = ((value == TB_WIN) == (player == 1)) ? WIN_SCORE : -WIN_SCORE;
+	return 1;
+}
+
+/**
+ * This function probes the tablebase and runs the threat analysis on the
+ * node's board, for boards that fit in a bitboard, before the node is
+ * searched. An exact tablebase score or a forced win or loss for the player
+ * to move is stored in the node's best_score.
+ * @param parent: the list node to analyze
+ * @param player: the player to move, 1 (maximizing) or 2
+ * @param columns: set to a bit per column worth searching
+ * @param task: the search task
+ * @return 1 when the node was scored and need not be searched
+ */
+static int presolve(struct list_node** parent, int player, unsigned int* columns, search_task* task)
+{
+	board* b = &(*parent) -> value;
+	bitboard bb;
+	threats t;
+
+	*columns = ~0u;
+	if (!bitboard_fits(b -> row_len, b -> column_len))
+		return 0;
+
+	bitboard_encode(b, &bb);
+	int score;
+	if (probe_tablebase(&bb, player, &score, task)) {
+		b -> best_score = score;
+		return 1;
+	}
+
+	threat_analyze(&bb, player, &t);
+	*columns = t.columns;
+	if (t.result == THREAT_WIN) {
+		b -> best_score = (player == 1) ? WIN_SCORE : -WIN_SCORE;
+		return 1;
+	} else if (t.result == THREAT_LOSS) {
+		b -> best_score = (player == 1) ? -WIN_SCORE : WIN_SCORE;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * This function picks the root move from the tablebase scores of the
+ * root's children, when they are all in the tablebase.
+ * @param parent: memory address of the game tree root
+ * @param maximizing: 1 when the player to move at the root is maximizing
+ * @return 1 when the move was found
+ */
+static int root_tablebase(struct list_node** parent, int maximizing)
+{
+	struct list* actions = (*parent) -> children;
+	int best = maximizing ? -999 : 999, move = -1;
+	int i;
+
+	if (search_tablebase == NULL || get_size(actions) == 0 ||
+			!bitboard_fits((*parent) -> value.row_len, (*parent) -> value.column_len))
+		return 0;
+
+	for (i = 0; i < get_size(actions); i++) {
+		struct list_node* action = &actions -> head[i];
+		bitboard bb;
+		int score;
+		bitboard_encode(&action -> value, &bb);
+		if (!probe_tablebase(&bb, maximizing ? 2 : 1, &score, NULL))
+			return 0;
+		action -> value.best_score = score;
+		if ((maximizing && score > best) || (!maximizing && score < best)) {
+			best = score;
+			move = action -> value.move;
+		}
+	}
+
+	(*parent) -> value.best_score = best;
+	(*parent) -> value.move = move;
+	return 1;
+}
+
+/**
+ * This function pushes a frame searching node onto the task's stack.
+ * @param t: the search task
+ * @param n: the node to search
+ * @param depth: remaining depth
+ * @param alpha: lower bound of the search window
+ * @param beta: upper bound of the search window
+ * @param maximizing: 1 when the player to move at node is maximizing
+ * @param root: 1 when node is the root, whose best move is recorded
+ */
+static void push_frame(search_task* t, struct list_node* n, int depth, int alpha, int beta,
+		int maximizing, int root)
+{
+	if (t -> top + 1 >= TASK_STACK) { error("Search stack overflow"); }
+	search_frame* f = &t -> stack[++t -> top];
+	f -> node = n;
+	f -> depth = depth;
+	f -> alpha = alpha;
+	f -> beta = beta;
+	f -> window_alpha = alpha;
+	f -> window_beta = beta;
+	f -> move = -1;
+	f -> batched = 0;
+	f -> maximizing = maximizing;
+	t -> pv_length[t -> top] = 0;
+	f -> root = root;
+	f -> stage = STAGE_ENTER;
+	f -> columns = root ? t -> columns : ~0u;
+	f -> extend = 0;
+	f -> extensions = (t -> top > 0) ? t -> stack[t -> top - 1].extensions + t -> stack[t -> top - 1].extend : 0;
+}
+
+/**
+ * This function pops the top frame. The root frame's score is kept in the
+ * task, since the root's best_score is only updated by improving moves.
+ * @param t: the search task
+ */
+static void pop_frame(search_task* t)
+{
+	search_frame* f = &t -> stack[t -> top--];
+	if (f -> root)
+		t -> score = f -> best;
+}
+
+/**
+ * This function stores the frame's finished search in the cache, as an
+ * upper bound when it failed low, a lower bound when it failed high, and
+ * exact otherwise. The root is stored by its task once an iteration ends.
+ * @param f: the frame
+ */
+static void store_frame(search_frame* f)
+{
+	int bound = TT_EXACT;
+	if (f -> root)
+		return;
+	if (f -> best <= f -> window_alpha)
+		bound = TT_UPPER;
+	else if (f -> best >= f -> window_beta)
+		bound = TT_LOWER;
+	store_cache(f -> node, f -> maximizing, f -> depth, bound, f -> best, f -> move);
+}
+
+/**
+ * This function scores the frame's node with the leaf heuristics.
+ * @param f: the frame
+ */
+static void evaluate_frame(search_frame* f)
+{
+	perf_begin(PERF_EVAL);
+	if (search_eval == EVAL_BITBOARD) {
+		bitboard bb;
+		bitboard_encode(&f -> node -> value, &bb);
+		f -> node -> value.best_score = eval_position(&search_evaluator, &bb);
+	} else if (search_eval == EVAL_NN) {
+		bitboard bb;
+		bitboard_encode(&f -> node -> value, &bb);
+		f -> node -> value.best_score = nn_position(search_network, &bb);
+	} else {
+		f -> node -> value.best_score = 0;
+		if (f -> maximizing)
+			get_best_max(&f -> node);
+		else
+			get_best_min(&f -> node);
+	}
+	perf_end(PERF_EVAL);
+}
+
+/**
+ * This function scores every child of a frame one ply above the leaves in
+ * a single batch, so the leaves need not be scored one at a time. Each
+ * child's bitboard is the parent's plus the checker it dropped; the network
+ * evaluator instead adds that checker to the parent's accumulator.
+ * @param f: the frame
+ */
+static void score_children(search_frame* f)
+{
+	struct list* actions = f -> node -> children;
+	board* b = &f -> node -> value;
+	eval_batch batch;
+	uint64_t cells[EVAL_BATCH];
+	bitboard bb;
+	int i;
+
+	bitboard_encode(b, &bb);
+	uint64_t playable = playable_cells(bb.mask, b -> row_len, b -> column_len);
+	eval_batch_clear(&batch);
+	for (i = 0; i < get_size(actions); i++) {
+		bitboard child = bb;
+		uint64_t cell = playable & column_mask(b -> row_len, actions -> head[i].value.move);
+		child.mask |= cell;
+		if (f -> maximizing)
+			child.p1 |= cell;
+		cells[i] = cell;
+		eval_batch_add(&batch, &child);
+	}
+	uint64_t start = trace_begin();
+	perf_begin(PERF_EVAL);
+	if (search_eval == EVAL_NN)
+		nn_moves(search_network, &bb, f -> maximizing ? 1 : 2, cells, batch.score, batch.count);
+	else
+		eval_batch_run(&search_evaluator, &batch);
+	perf_end(PERF_EVAL);
+	trace_end_arg("eval batch", "eval", start, "positions", batch.count);
+	for (i = 0; i < batch.count; i++) {
+		actions -> head[i].value.best_score = batch.score[i];
+	}
+	f -> batched = 1;
+}
+
+/**
+ * This function advances the frame's child index to the next child the
+ * threat analysis allows, starting at the current index.
+ * @param f: the frame
+ * @return 1 when there is such a child
+ */
+static int next_child(search_frame* f)
+{
+	struct list* actions = f -> node -> children;
+	int n = get_size(actions);
+	while (f -> index < n && !(f -> columns & (1u << actions -> head[f -> index].value.move)))
+		f -> index++;
+	return f -> index < n;
+}
+
+/**
+ * This function returns the score a root move must beat to be among the
+ * k best found so far, or the open bound while fewer than k are known.
+ * @param t: the search task
+ */
+static int kth_score(search_task* t)
+{
+	int scores[BOARD_MAX_CELLS];
+	int i, j;
+	if (t -> num_lines < t -> multipv)
+		return t -> maximizing ? -999 : 999;
+
+	// Order the scores best-first
+	for (i = 0; i < t -> num_lines; i++) {
+		int score = t -> lines[i].score;
+		for (j = i; j > 0 && (t -> maximizing ? scores[j-1] < score : scores[j-1] > score); j--)
+			scores[j] = scores[j-1];
+		scores[j] = score;
+	}
+	return scores[t -> multipv - 1];
+}
+
+/**
+ * This function records the root move just searched as a line.
+ * @param t: the search task
+ * @param action: the root child searched
+ * @param exact: 1 when the child's score lies inside its search window
+ */
+static void record_line(search_task* t, struct list_node* action, int exact)
+{
+	search_line* line = &t -> lines[t -> num_lines++];
+	line -> move = action -> value.move;
+	line -> score = action -> value.best_score;
+	line -> exact = exact;
+	line -> pv[0] = line -> move;
+	line -> length = 1;
+	// A bound comes from a null-window search, which has no variation
+	if (exact) {
+		memcpy(&line -> pv[1], t -> pv[1], t -> pv_length[1]);
+		line -> length += t -> pv_length[1];
+	}
+}
+
+/**
+ * This function returns the remaining depth of the frame's children: one
+ * ply less, unless the frame's move is forced and extended.
+ * @param f: the frame
+ */
+static int child_depth(search_frame* f)
+{
+	return f -> depth - 1 + f -> extend;
+}
+
+/**
+ * This function pushes the frame's current child with a null window at
+ * alpha, or at beta when the frame is minimizing.
+ * @param t: the search task
+ * @param f: the frame, on top of the stack
+ * @param depth: remaining depth for the child
+ */
+static void push_scout(search_task* t, search_frame* f, int depth)
+{
+	struct list_node* action = &f -> node -> children -> head[f -> index];
+	if (f -> maximizing)
+		push_frame(t, action, depth, f -> alpha, f -> alpha + 1, 0, 0);
+	else
+		push_frame(t, action, depth, f -> beta - 1, f -> beta, 1, 0);
+}
+
+/**
+ * This function advances the search by one step: it enters the top frame's
+ * node or handles the result of the child it last pushed. Each node is
+ * searched with principal variation search: the first child with the full
+ * window and the rest with a null window, re-searching any child whose
+ * score lands inside the window. Late children of deep nodes get their
+ * null-window search at a reduced depth first. Scores are stored in each
+ * node's best_score; a score <= alpha is an upper bound and >= beta a
+ * lower bound.
+ * @param t: the search task, with a non-empty stack
+ */
+static void step(search_task* t)
+{
+	search_frame* f = &t -> stack[t -> top];
+	struct list_node* parent = f -> node;
+	struct list* actions = parent -> children;
+	struct list_node* action;
+	tt_result cached;
+	int score, bounded = 0;
+
+	switch (f -> stage) {
+	case STAGE_ENTER:
+		t -> nodes++;
+		search_nodes++;
+		if (!f -> root) {
+			perf_begin(PERF_TERMINAL);
+			int finished = terminal_test(&parent -> value) > 0;
+			perf_end(PERF_TERMINAL);
+			if (finished) {
+				evaluate_frame(f);
+				pop_frame(t);
+				return;
+			} else if (presolve(&parent, f -> maximizing ? 1 : 2, &f -> columns, t)) {
+				// forced win or loss
+				pop_frame(t);
+				return;
+			}
+			// A single reply is searched without using up a ply
+			f -> extend = search_extensions && f -> extensions < FORCED_EXTENSIONS &&
+					__builtin_popcount(f -> columns) == 1;
+			if ((f -> depth == 0 && !f -> extend) || get_size(actions) == 0) {
+				// leaves below a batched frame are already scored
+				if (f -> depth > 0 || t -> top == 0 || !t -> stack[t -> top - 1].batched)
+					evaluate_frame(f);
+				pop_frame(t);
+				return;
+			}
+
+			cached.move = -1;
+			if (probe_cache(parent, f -> maximizing, &cached, t) && cached.depth >= f -> depth &&
+					(cached.bound == TT_EXACT ||
+					(cached.bound == TT_LOWER && cached.score >= f -> beta) ||
+					(cached.bound == TT_UPPER && cached.score <= f -> alpha))) {
+				// searched at least as deep before
+				parent -> value.best_score = cached.score;
+				pop_frame(t);
+				return;
+			}
+			if (f -> depth > 1)
+				sort_list(actions, f -> maximizing);
+			if (cached.move >= 0)
+				move_to_front(actions, cached.move);
+		}
+		if (f -> depth == 1 && !f -> extend && search_eval != EVAL_HEURISTIC)
+			score_children(f);
+
+		f -> best = f -> maximizing ? -999 : 999;
+		f -> index = 0;
+		if (!next_child(f)) {
+			// every move was ruled out
+			if (!f -> root)
+				evaluate_frame(f);
+			pop_frame(t);
+			return;
+		}
+		f -> stage = STAGE_FULL;
+		push_frame(t, &actions -> head[f -> index], child_depth(f), f -> alpha, f -> beta,
+				!f -> maximizing, 0);
+		return;
+
+	case STAGE_REDUCED:
+		action = &actions -> head[f -> index];
+		score = action -> value.best_score;
+		if (f -> maximizing ? score > f -> alpha : score < f -> beta) {
+			// the shallow search says the move is better, verify it
+			f -> stage = STAGE_SCOUT;
+			push_scout(t, f, child_depth(f));
+			return;
+		}
+		// fall through, the reduced bound stands
+	case STAGE_SCOUT:
+		action = &actions -> head[f -> index];
+		score = action -> value.best_score;
+		if (score > f -> alpha && score < f -> beta) {
+			f -> stage = STAGE_FULL;
+			push_frame(t, action, child_depth(f), f -> alpha, f -> beta, !f -> maximizing, 0);
+			return;
+		}
+		// fall through, the scout's bound is good enough
+		bounded = 1;
+	case STAGE_FULL:
+		action = &actions -> head[f -> index];
+		score = f -> best;
+		if (f -> maximizing)
+			max(&f -> best, &action, &parent);
+		else
+			min(&f -> best, &action, &parent);
+		if (f -> best != score) {
+			f -> move = action -> value.move;
+			if (f -> root)
+				parent -> value.move = f -> move;
+			// The child's variation follows its move
+			t -> pv[t -> top][0] = f -> move;
+			memcpy(&t -> pv[t -> top][1], t -> pv[t -> top + 1], t -> pv_length[t -> top + 1]);
+			t -> pv_length[t -> top] = t -> pv_length[t -> top + 1] + 1;
+		}
+
+		if (f -> maximizing ? (f -> best >= f -> beta) : (f -> best <= f -> alpha)) {
+			store_frame(f);
+			pop_frame(t);
+			return;
+		}
+		if (f -> root && t -> multipv > 0) {
+			// Later moves need only beat the k-th best to get an exact score
+			score = action -> value.best_score;
+			record_line(t, action, !bounded && score > f -> alpha && score < f -> beta);
+			if (f -> maximizing)
+				f -> alpha = kth_score(t);
+			else
+				f -> beta = kth_score(t);
+		} else if (f -> maximizing) {
+			f -> alpha = (f -> alpha > f -> best) ? f -> alpha : f -> best;
 		} else {
-			permutation -> move = i;
-			struct list_node* child = create_node(permutation);
-			add_child(parent, &child);
+			f -> beta = (f -> beta < f -> best) ? f -> beta : f -> best;
+		}
+
+		f -> index++;
+		if (!next_child(f)) {
+			store_frame(f);
+			pop_frame(t);
+			return;
+		}
+		if (f -> root && t -> num_lines < t -> multipv) {
+			f -> stage = STAGE_FULL;
+			push_frame(t, &actions -> head[f -> index], child_depth(f), f -> alpha, f -> beta,
+					!f -> maximizing, 0);
+			return;
+		}
+		// Late moves of a well-ordered list rarely matter, so look at
+		// them shallower first
+		if (search_reductions && !f -> root && f -> index >= LMR_FULL_MOVES && f -> depth >= LMR_MIN_DEPTH) {
+			f -> stage = STAGE_REDUCED;
+			push_scout(t, f, child_depth(f) - LMR_REDUCTION);
+			return;
+		}
+		f -> stage = STAGE_SCOUT;
+		push_scout(t, f, child_depth(f));
+		return;
+	}
+}
+
+/**
+ * This function prepares the root before the first iteration: a position
+ * covered by the tablebase or with an immediate win is decided without
+ * searching, and moves the threat analysis shows to lose are ruled out.
+ * @param t: the search task
+ * @return 1 when the move was decided
+ */
+static int prepare_root(search_task* t)
+{
+	struct list_node* root = t -> root;
+	board* b = &root -> value;
+
+	t -> columns = ~0u;
+	if (root_tablebase(&root, t -> maximizing))
+		return 1;
+	if (bitboard_fits(b -> row_len, b -> column_len)) {
+		bitboard bb;
+		threats th;
+		bitboard_encode(b, &bb);
+		threat_analyze(&bb, t -> maximizing ? 1 : 2, &th);
+		t -> columns = th.columns;
+		if (th.result == THREAT_WIN) {
+			b -> best_score = t -> maximizing ? WIN_SCORE : -WIN_SCORE;
+			b -> move = __builtin_ctz(t -> columns);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * This function takes the root move from the cache when a previous run
+ * searched the root position to full depth.
+ * @param t: the search task
+ * @return 1 when the move was found
+ */
+static int root_cache(search_task* t)
+{
+	struct list_node* root = t -> root;
+	tt_result cached;
+
+	if (!probe_cache(root, t -> maximizing, &cached, t) || cached.depth < search_depth ||
+			cached.bound != TT_EXACT || cached.move < 0 || get_cell(&root -> value, cached.move) != 0)
+		return 0;
+	root -> value.best_score = cached.score;
+	root -> value.move = cached.move;
+	t -> reached = cached.depth;
+	return 1;
+}
+
+/**
+ * This function creates a search task deciding the move at root. The task
+ * runs an iterative deepening search to the search depth, each iteration
+ * searching an aspiration window around the previous iteration's score and
+ * widening it whenever the result falls outside. The root's children are
+ * reordered best-first by the previous iteration's scores. The game tree
+ * must outlive the task.
+ * @param root: the game tree root
+ * @param maximizing: 1 when the player to move at the root is maximizing
+ * @return an initialized task, not yet started
+ */
+search_task* create_task(struct list_node* root, int maximizing)
+{
+	search_task* t = (search_task*) malloc(sizeof(search_task));
+	if (t == NULL) { error("Could not allocate memory for search task"); }
+	t -> root = root;
+	t -> maximizing = maximizing;
+	t -> state = TASK_START;
+	t -> cancel = 0;
+	t -> nodes = 0;
+	t -> top = -1;
+	t -> depth = 0;
+	t -> score = 0;
+	t -> best_move = -1;
+	t -> best_score = 0;
+	t -> reached = 0;
+	t -> cache_probes = 0;
+	t -> cache_hits = 0;
+	t -> tablebase_probes = 0;
+	t -> tablebase_hits = 0;
+	t -> pv_length[0] = 0;
+	t -> columns = ~0u;
+	t -> multipv = 0;
+	t -> num_lines = 0;
+	t -> lines = NULL;
+	return t;
+}
+
+/**
+ * This function deallocates a search task. The game tree is untouched.
+ * @param t: the task to delete
+ */
+void delete_task(search_task* t)
+{
+	free(t -> lines);
+	free(t);
+}
+
+/**
+ * This function puts a task that has not started into multi-PV mode. Every
+ * root move is searched and recorded as a line; the k best get exact
+ * scores, the others upper bounds (lower bounds when minimizing). Root
+ * aspiration windows are turned off so the lines stay exact.
+ * @param t: the search task
+ * @param k: number of exact lines wanted, at least 1
+ */
+void set_multipv(search_task* t, int k)
+{
+	free(t -> lines);
+	t -> multipv = k;
+	t -> lines = (search_line*) malloc(sizeof(search_line) * (get_size(t -> root -> children) + 1));
+	if (t -> lines == NULL) { error("Could not allocate memory for search lines"); }
+}
+
+/**
+ * This function asks a task to stop. It is safe to call from another
+ * thread; the task stops at its next step and reports the best move of the
+ * last completed iteration, or -1 when no iteration completed.
+ * @param t: the task to cancel
+ */
+void cancel_task(search_task* t)
+{
+	__atomic_store_n(&t -> cancel, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * This function runs a task until it finishes, is cancelled, or has visited
+ * max_nodes more nodes, whichever is first. A suspended task continues
+ * exactly where it left off on the next call.
+ * @param t: the task to run
+ * @param max_nodes: node budget for this call, or 0 for no limit
+ * @return TASK_DONE, TASK_CANCELLED or TASK_SUSPENDED
+ */
+int run_task(search_task* t, long max_nodes)
+{
+	long limit = t -> nodes + max_nodes;
 
-			if (terminal_test(permutation) > 0) {
-				// fall through, don't enumerate finished board
+	while (t -> state != TASK_DONE && t -> state != TASK_CANCELLED) {
+		if (__atomic_load_n(&t -> cancel, __ATOMIC_RELAXED)) {
+			t -> state = TASK_CANCELLED;
+			break;
+		}
+		if (max_nodes > 0 && t -> nodes >= limit)
+			return TASK_SUSPENDED;
+
+		if (t -> top >= 0) {
+			step(t);
+			continue;
+		}
+
+		switch (t -> state) {
+		case TASK_START:
+			// Multi-PV scores every root move, so nothing is decided early
+			if (t -> multipv > 0)
+				t -> state = TASK_NEXT;
+			else
+				t -> state = (prepare_root(t) || root_cache(t)) ? TASK_DONE : TASK_NEXT;
+			break;
+
+		case TASK_ITERATION:
+			// Widen the aspiration window and re-search on a miss
+			if (t -> score <= t -> alpha && t -> alpha > -999) {
+				t -> alpha = -999;
+			} else if (t -> score >= t -> beta && t -> beta < 999) {
+				t -> beta = 999;
 			} else {
-				generate_permutations(&child, child->value, nth_perm, player);
+				t -> best_move = t -> root -> value.move;
+				t -> best_score = t -> score;
+				t -> reached = t -> depth;
+				trace_end_arg("iteration", "search", t -> trace_start, "depth", t -> depth);
+				// One summary per iteration, not a span per probe
+				if (search_cache != NULL)
+					trace_end_args("cache probes", "cache", t -> trace_start,
+							"probes", t -> cache_probes, "hits", t -> cache_hits);
+				if (search_tablebase != NULL)
+					trace_end_args("tablebase probes", "tablebase", t -> trace_start,
+							"probes", t -> tablebase_probes, "hits", t -> tablebase_hits);
+				store_cache(t -> root, t -> maximizing, t -> depth, TT_EXACT, t -> score, t -> best_move);
+				t -> state = TASK_NEXT;
+				break;
+			}
+			push_frame(t, t -> root, t -> depth, t -> alpha, t -> beta, t -> maximizing, 1);
+			break;
+
+		case TASK_NEXT:
+			if (++t -> depth > search_depth) {
+				t -> state = TASK_DONE;
+				break;
 			}
+			t -> alpha = -999;
+			t -> beta = 999;
+			t -> num_lines = 0;
+			if (t -> depth > 1 && t -> multipv == 0) {
+				t -> alpha = t -> score - ASPIRATION_WINDOW;
+				t -> beta = t -> score + ASPIRATION_WINDOW;
+			}
+			sort_list(t -> root -> children, t -> maximizing);
+			push_frame(t, t -> root, t -> depth, t -> alpha, t -> beta, t -> maximizing, 1);
+			t -> state = TASK_ITERATION;
+			t -> trace_start = trace_begin();
+			t -> cache_probes = 0;
+			t -> cache_hits = 0;
+			t -> tablebase_probes = 0;
+			t -> tablebase_hits = 0;
+			break;
+		}
+	}
+
+	// A cancelled task reports the last completed iteration, if any
+	if (t -> state == TASK_CANCELLED) {
+		t -> root -> value.move = t -> best_move;
+		t -> root -> value.best_score = t -> best_score;
+	}
+	t -> top = -1;
+	return t -> state;
+}
+
+/**
+ * This function runs several tasks on the calling thread, giving each a
+ * slice of slice nodes in turn until all have finished or been cancelled.
+ * @param tasks: the tasks to run
+ * @param num_tasks: the number of tasks
+ * @param slice: nodes per task per turn
+ */
+void run_tasks(search_task** tasks, int num_tasks, long slice)
+{
+	int running = num_tasks;
+	while (running > 0) {
+		int i;
+		running = 0;
+		for (i = 0; i < num_tasks; i++) {
+			if (tasks[i] -> state == TASK_DONE || tasks[i] -> state == TASK_CANCELLED)
+				continue;
+			uint64_t start = trace_begin();
+			if (run_task(tasks[i], slice) == TASK_SUSPENDED)
+				running++;
+			trace_end_arg("task slice", "search", start, "task", i);
 		}
 	}
 }
 
+/**
+ * This function runs a task to completion.
+ * @param parent: memory address of the game tree root
+ * @param maximizing: 1 when the player to move at the root is maximizing
+ */
+static void decide(struct list_node** parent, int maximizing)
+{
+	uint64_t start = trace_begin();
+	search_task* t = create_task(*parent, maximizing);
+	if (search_time > 0) {
+		struct timespec begin, now;
+		clock_gettime(CLOCK_MONOTONIC, &begin);
+		while (run_task(t, DECIDE_SLICE) == TASK_SUSPENDED) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			long elapsed = (now.tv_sec - begin.tv_sec) * 1000L + (now.tv_nsec - begin.tv_nsec) / 1000000;
+			// Keep going until the first iteration has a move to report
+			if (elapsed >= search_time && t -> best_move >= 0)
+				cancel_task(t);
+		}
+	} else {
+		run_task(t, 0);
+	}
+	search_depth_reached = t -> reached;
+
+	// A cancelled iteration may have left another move's variation
+	int move = (*parent) -> value.move;
+	if (t -> pv_length[0] > 0 && t -> pv[0][0] == move) {
+		search_pv_length = t -> pv_length[0];
+		memcpy(search_pv, t -> pv[0], search_pv_length);
+	} else {
+		search_pv_length = (move >= 0);
+		search_pv[0] = move;
+	}
+	trace_end_arg("decide", "search", start, "nodes", t -> nodes);
+	delete_task(t);
+}
+
 /**
  * This function returns the maximum decision for the player.
  * It takes the root node of the game tree as an argument and calculates the
@@ -111,20 +1220,7 @@ void generate_permutations(struct list_node** parent, board* b, int nth_perm, in
  */
 void max_decision(struct list_node** parent)
 {
-	int alpha = -999, beta = 999;
-	struct list* actions = (struct list*) (*parent) -> children;
-	struct list_node* action = (struct list_node*) actions -> head;
-
-	int best = -999;
-	while (action != NULL) {
-		min_value(&action, &alpha, &beta);
-		if (best < action -> value -> best_score) {
-			best = action -> value -> best_score;
-			(*parent) -> value -> best_score = best;
-			(*parent) -> value -> move = action -> value -> move;
-		}
-		action = (struct list_node*) action -> next;
-	}
+	decide(parent, 1);
 }
 
 /**
@@ -136,76 +1232,195 @@ void max_decision(struct list_node** parent)
  */
 void min_decision(struct list_node** parent)
 {
-	int alpha = -999, beta = 999;
-	struct list* actions = (struct list*) (*parent) -> children;
-	struct list_node* action = (struct list_node*) actions -> head;
+	decide(parent, 0);
+}
+
+/**
+ * This function scores every root move in one search: the k best exactly,
+ * with their principal variations, and the rest as bounds. The moves share
+ * the search's move ordering and transposition cache. On a symmetric board
+ * only one of each pair of mirrored moves is searched, and the other gets
+ * the mirrored line. The root's best_score and move are set as by
+ * max_decision() and min_decision().
+ * @param parent: memory address of the game tree root
+ * @param maximizing: 1 when the player to move at the root is maximizing
+ * @param k: number of exact lines wanted, at least 1
+ * @param lines: filled best-first, room for one line per column
+ * @return the number of lines
+ */
+int multipv_decision(struct list_node** parent, int maximizing, int k, search_line* lines)
+{
+	board* b = &(*parent) -> value;
+	search_task* t = create_task(*parent, maximizing);
+	int i, j, n;
+
+	set_multipv(t, k);
+	run_task(t, 0);
+	search_depth_reached = t -> reached;
+	n = t -> num_lines;
+	memcpy(lines, t -> lines, sizeof(search_line) * n);
+	delete_task(t);
+	search_pv_length = 0;
+
+	if (board_is_symmetric(b)) {
+		int searched = n;
+		for (i = 0; i < searched; i++) {
+			int mirror = mirror_column(b -> column_len, lines[i].move);
+			if (mirror == lines[i].move)
+				continue;
+			lines[n] = lines[i];
+			for (j = 0; j < lines[n].length; j++)
+				lines[n].pv[j] = mirror_column(b -> column_len, lines[n].pv[j]);
+			lines[n].move = mirror;
+			n++;
+		}
+	}
 
-	int best = 999;
-	while (action != NULL) {
-		max_value(&action, &alpha, &beta);
-		if (best > action -> value -> best_score) {
-			best = action -> value -> best_score;
-			(*parent) -> value -> best_score = best;
-			(*parent) -> value -> move = action -> value -> move;
+	// Best-first, exact lines ahead of bounds with the same score
+	for (i = 1; i < n; i++) {
+		search_line line = lines[i];
+		for (j = i; j > 0; j--) {
+			search_line* other = &lines[j-1];
+			int better = maximizing ? (line.score > other -> score) : (line.score < other -> score);
+			if (!better && !(line.score == other -> score && line.exact && !other -> exact))
+				break;
+			lines[j] = lines[j-1];
 		}
-		action = (struct list_node*) action -> next;
+		lines[j] = line;
 	}
+	return n;
 }
 
 /**
- * This function performs a depth-first search on the given list node until
- * it finds a terminal state or a nested child node with no children.
- * It attempts to find and return the maximum value of the children of the
- * parent node.
+ * This function searches a subtree to completion on an explicit stack.
  * @param parent: the list node whose children are to be searched
+ * @param depth: remaining depth
+ * @param alpha: lower bound of the search window
+ * @param beta: upper bound of the search window
+ * @param maximizing: 1 when the player to move at parent is maximizing
  */
-void min_value(struct list_node** parent, int* alpha, int* beta)
+static void search_subtree(struct list_node** parent, int depth, int alpha, int beta, int maximizing)
 {
-	if (terminal_test((*parent) -> value) > 0) {
-		get_best_min(parent);
-	} else if (get_size((*parent) -> children) == 0) {
-		get_best_min(parent);
-	} else {
-		struct list* actions = (*parent) -> children;
-		struct list_node* action = (struct list_node*) actions -> head;
-		int best = 999;
+	search_task t;
+	t.top = -1;
+	t.nodes = 0;
+	t.multipv = 0;
+	t.num_lines = 0;
+	t.cache_probes = 0;
+	t.cache_hits = 0;
+	t.tablebase_probes = 0;
+	t.tablebase_hits = 0;
+	push_frame(&t, *parent, depth, alpha, beta, maximizing, 0);
+	while (t.top >= 0)
+		step(&t);
+}
 
-		while (action != NULL) {
-			max_value(&action, alpha, beta);
-			min(&best, &action, parent);
-			if (best <= *alpha) { return; }
-			*beta = (*beta < best) ? *beta : best;
-			action = (struct list_node*) action -> next;
-		}
-	}
+/**
+ * This function finds the minimum value of the children of the parent node
+ * to the given depth. The result is stored in the node's best_score and is
+ * an upper bound when it is <= alpha and a lower bound when it is >= beta.
+ * @param parent: the list node whose children are to be searched
+ * @param depth: remaining depth
+ * @param alpha: lower bound of the search window
+ * @param beta: upper bound of the search window
+ */
+void min_value(struct list_node** parent, int depth, int alpha, int beta)
+{
+	search_subtree(parent, depth, alpha, beta, 0);
 }
 
 /**
- * This function performs a depth-first search on the given list node until
- * it finds a terminal state or a nested child node with no children.
- * It attempts to find and return the minimum value of the children of the
- * parent node.
+ * This function finds the maximum value of the children of the parent node
+ * to the given depth. The result is stored in the node's best_score and is
+ * an upper bound when it is <= alpha and a lower bound when it is >= beta.
  * @param parent: the list node whose children are to be searched
+ * @param depth: remaining depth
+ * @param alpha: lower bound of the search window
+ * @param beta: upper bound of the search window
  */
-void max_value(struct list_node** parent, int* alpha, int* beta)
+void max_value(struct list_node** parent, int depth, int alpha, int beta)
 {
-	if (terminal_test((*parent) -> value) > 0) {
-		get_best_max(parent);
-	} else if (get_size((*parent) -> children) == 0) {
-		get_best_max(parent);
-	} else {
-		struct list* actions = (*parent) -> children;
-		struct list_node* action = (struct list_node*) actions -> head;
-		int best = -999;
+	search_subtree(parent, depth, alpha, beta, 1);
+}
 
-		while (action != NULL) {
-			min_value(&action, alpha, beta);
-			max(&best, &action, parent);
-			if (best >= *beta) { return; }
-			*alpha = (*alpha > best) ? *alpha : best;
-			action = (struct list_node*) action -> next;
-		}
+/**
+ * Returns the number of nodes visited since the last reset.
+ */
+long get_search_nodes()
+{
+	return search_nodes;
+}
+
+/**
+ * Returns the depth of the last completed iteration of the last decision
+ * (max_decision(), min_decision() or multipv_decision()), 0 when the move
+ * needed no search.
+ */
+int get_search_depth()
+{
+	return search_depth_reached;
+}
+
+/**
+ * Copies the principal variation of the last max_decision() or
+ * min_decision(), starting with the move it chose.
+ * @param pv: room for TASK_STACK columns
+ * @return the number of columns, 0 when there is none
+ */
+int get_search_pv(signed char* pv)
+{
+	memcpy(pv, search_pv, search_pv_length);
+	return search_pv_length;
+}
+
+/**
+ * Returns the search limits max_decision() and min_decision() run with.
+ * @param depth: set to the depth in plies
+ * @param ms: set to the time per decision, 0 for none
+ */
+void get_search_limits(int* depth, long* ms)
+{
+	*depth = search_depth;
+	*ms = search_time;
+}
+
+/**
+ * Returns a number that changes whenever a setting other than the search
+ * limits changes what the decision functions return, so results kept
+ * from earlier decisions can be discarded.
+ */
+unsigned long get_search_epoch()
+{
+	return search_epoch;
+}
+
+/**
+ * Returns a fingerprint of the settings that decide the scores the search
+ * stores: the leaf evaluator, with the network's hash when it is EVAL_NN,
+ * and the reduction and extension switches.
+ * Unlike get_search_epoch() it is the same in every process with the same
+ * settings, so files of search results can be checked against it.
+ */
+uint64_t get_search_settings()
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	int values[3] = { search_eval, search_reductions, search_extensions };
+	int i;
+	for (i = 0; i < 3; i++) {
+		h ^= (uint64_t) values[i];
+		h *= 0x100000001b3ULL;
 	}
+	if (search_eval == EVAL_NN && search_network != NULL)
+		h = (h ^ search_network -> hash) * 0x100000001b3ULL;
+	return h;
+}
+
+/**
+ * Resets the visited node counter.
+ */
+void reset_search_nodes()
+{
+	search_nodes = 0;
 }
 
 /**
@@ -218,9 +1433,9 @@ void max_value(struct list_node** parent, int* alpha, int* beta)
  */
 void min(int* best, struct list_node** action, struct list_node** parent)
 {
-	if (*best > (*action) -> value -> best_score) {
-		*best = (*action) -> value -> best_score;
-		(*parent) -> value -> best_score = *best;
+	if (*best > (*action) -> value.best_score) {
+		*best = (*action) -> value.best_score;
+		(*parent) -> value.best_score = *best;
 	}
 }
 
@@ -234,9 +1449,9 @@ void min(int* best, struct list_node** action, struct list_node** parent)
  */
 void max(int* best, struct list_node** action, struct list_node** parent)
 {
-	if (*best < (*action) -> value -> best_score) {
-		*best = (*action) -> value -> best_score;
-		(*parent) -> value -> best_score = *best;
+	if (*best < (*action) -> value.best_score) {
+		*best = (*action) -> value.best_score;
+		(*parent) -> value.best_score = *best;
 	}
 }
 
@@ -271,13 +1486,13 @@ void get_best_min(struct list_node** parent)
  */
 void best_vertical_max(struct list_node** parent)
 {
-	board* b = (*parent) -> value;
+	board* b = &(*parent) -> value;
 	int best = -1;
 
 	/*if (terminal_test(b) == 1) {
-		best = (*parent) -> value -> best_score = 10;
+		best = (*parent) -> value.best_score = 10;
 	} else if (terminal_test(b) == 2) {
-		best = (*parent) -> value -> best_score = -10;
+		best = (*parent) -> value.best_score = -10;
 	} else {*/
 	int num_cols = b->column_len;
 	int r = b->r;
@@ -288,7 +1503,7 @@ void best_vertical_max(struct list_node** parent)
 	// End index, first non-zero index
 	int end = move;
 	while (end < b->size) {
-		if (b->array[end] != 0) {
+		if (get_cell(b, end) != 0) {
 			break;
 		} else {
 			end += num_cols;
@@ -308,11 +1523,11 @@ void best_vertical_max(struct list_node** parent)
 		for (j = 0; j < b -> r; j++) {
 
 			// Make sure index is within range
-			if (i + j * num_cols > b -> size) {
+			if (i + j * num_cols >= b -> size) {
 				invalid = 1;
 				break;
 			} else {
-				int current = b -> array[i + j * num_cols];
+				int current = get_cell(b, i + j * num_cols);
 				if (current == 1)
 					p1 += 1;
 				else if (current == 2)
@@ -340,8 +1555,8 @@ void best_vertical_max(struct list_node** parent)
 			else if (p2 == -2 && p1 == 0)
 				best = -3;
 
-			if (best < (*parent) -> value -> best_score) {
-				(*parent) -> value -> best_score = best;
+			if (best < (*parent) -> value.best_score) {
+				(*parent) -> value.best_score = best;
 				//printf("BEST VERTICAL MOVE %d SCORE %d\n", move, best);
 				//print_board(b);
 			}
@@ -357,13 +1572,13 @@ void best_vertical_max(struct list_node** parent)
  */
 void best_vertical_min(struct list_node** parent)
 {
-	board* b = (*parent) -> value;
+	board* b = &(*parent) -> value;
 	int best = -1;
 
 	/*if (terminal_test(b) == 1) {
-		best = (*parent) -> value -> best_score = 10;
+		best = (*parent) -> value.best_score = 10;
 	} else if (terminal_test(b) == 2) {
-		best = (*parent) -> value -> best_score = -10;
+		best = (*parent) -> value.best_score = -10;
 	} else {*/
 	int num_cols = b->column_len;
 	int r = b->r;
@@ -374,7 +1589,7 @@ void best_vertical_min(struct list_node** parent)
 	// Find target index, first non-zero index
 	int target = move;
 	while (target < b->size) {
-		if (b->array[target] != 0) {
+		if (get_cell(b, target) != 0) {
 			break;
 		} else {
 			target += num_cols;
@@ -406,11 +1621,11 @@ void best_vertical_min(struct list_node** parent)
 			for (j = 0; j < b -> r; j++) {
 
 				// Make sure index is within range
-				if (i + j * num_cols > b -> size) {
+				if (i + j * num_cols >= b -> size) {
 					invalid = 1;
 					break;
 				} else {
-					int current = b -> array[i + j * num_cols];
+					int current = get_cell(b, i + j * num_cols);
 					//printf("%d", current);
 					if (current == 1)
 						p1 += 1;
@@ -440,8 +1655,8 @@ void best_vertical_min(struct list_node** parent)
 				else if (p1 == 0 && p2 == -2)
 					best = 3;
 
-				if (best > (*parent) -> value -> best_score) {
-					(*parent) -> value -> best_score = best;
+				if (best > (*parent) -> value.best_score) {
+					(*parent) -> value.best_score = best;
 					//printf("BEST VERTICAL MAX %d %d\n", best, move);
 				}
 			}
@@ -457,13 +1672,13 @@ void best_vertical_min(struct list_node** parent)
  */
 void best_horizontal_max(struct list_node** parent)
 {
-	board* b = (*parent) -> value;
+	board* b = &(*parent) -> value;
 	int best = -1;
 
 	/*if (terminal_test(b) == 1) {
-		best = (*parent) -> value -> best_score = 10;
+		best = (*parent) -> value.best_score = 10;
 	} else if (terminal_test(b) == 2) {
-		best = (*parent) -> value -> best_score = -10;
+		best = (*parent) -> value.best_score = -10;
 	} else {*/
 	int num_cols = b->column_len;
 	int r = b->r;
@@ -475,7 +1690,7 @@ void best_horizontal_max(struct list_node** parent)
 	// first non-zero index in column where checker was placed
 	int target = move;
 	while (target < b->size) {
-		if (b->array[target] != 0) {
+		if (get_cell(b, target) != 0) {
 			break;
 		} else {
 			target += num_cols;
@@ -516,11 +1731,11 @@ void best_horizontal_max(struct list_node** parent)
 			int temp, invalid = 0;
 			for (j = 0; j < r; j++) {
 				// Make sure row below has checker
-				if (i + j + 7 < b->size && b->array[i+j+7] == 0) {
+				if (i + j + 7 < b->size && get_cell(b, i+j+7) == 0) {
 					invalid = 1;
 					break;
 				} else {
-					int current = b -> array[i + j];
+					int current = get_cell(b, i + j);
 					//printf("%d", current);
 					if (current == 1)
 						p1 += 1;
@@ -547,8 +1762,8 @@ void best_horizontal_max(struct list_node** parent)
 				else if (p2 == 0 && p1 == 2)
 					best = -3;
 
-				if (best < (*parent) -> value -> best_score) {
-					(*parent) -> value -> best_score = best;
+				if (best < (*parent) -> value.best_score) {
+					(*parent) -> value.best_score = best;
 					//printf("MIN HORIZONTAL MOVE %d SCORE %d\n", move, best);
 					//print_board(b);
 				}
@@ -565,13 +1780,13 @@ void best_horizontal_max(struct list_node** parent)
  */
 void best_horizontal_min(struct list_node** parent)
 {
-	board* b = (*parent) -> value;
+	board* b = &(*parent) -> value;
 	int best = -1;
 
 	/*if (terminal_test(b) == 1) {
-		best = (*parent) -> value -> best_score = 10;
+		best = (*parent) -> value.best_score = 10;
 	} else if (terminal_test(b) == 2) {
-		best = (*parent) -> value -> best_score = -10;
+		best = (*parent) -> value.best_score = -10;
 	} else {*/
 	int num_cols = b->column_len;
 	int r = b->r;
@@ -582,7 +1797,7 @@ void best_horizontal_min(struct list_node** parent)
 	// Find target index, first non-zero index in column where checker was placed
 	int target = move;
 	while (target < b->size) {
-		if (b->array[target] != 0) {
+		if (get_cell(b, target) != 0) {
 			break;
 		} else {
 			target += num_cols;
@@ -623,11 +1838,11 @@ void best_horizontal_min(struct list_node** parent)
 			int temp, invalid = 0;
 			for (j = 0; j < r; j++) {
 				// Make sure row below has checker
-				if (i + j + 7 < b->size && b->array[i+j+7] == 0) {
+				if (i + j + 7 < b->size && get_cell(b, i+j+7) == 0) {
 					invalid = 1;
 					break;
 				} else {
-					int current = b -> array[i + j];
+					int current = get_cell(b, i + j);
 					//printf("%d", current);
 					if (current == 1)
 						p1 += 1;
@@ -654,8 +1869,8 @@ void best_horizontal_min(struct list_node** parent)
 				else if (p1 == 0 && p2 == -2)
 					best = 3;
 
-				if (best > (*parent) -> value -> best_score) {
-					(*parent) -> value -> best_score = best;
+				if (best > (*parent) -> value.best_score) {
+					(*parent) -> value.best_score = best;
 					//printf("BEST SCORE MAX SCORE %d MOVE %d\n", best, move);
 				}
 			}
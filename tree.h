@@ -6,15 +6,123 @@
  */
 #include "board.h"
 #include "linked_list.h"
+#include "tablebase.h"
+#include "ttable.h"
+#include "eval.h"
+#include "nnue.h"
 
 #ifndef TREE_H_
 #define TREE_H_
 
+/* Plies generated below the root and searched by the decision functions,
+ * unless set_search_depth() says otherwise */
+#define SEARCH_DEPTH 6
+/* Score of a won position for player 1; player 2's wins score -WIN_SCORE */
+#define WIN_SCORE 10
+/* Half-width of the root aspiration window around the previous score */
+#define ASPIRATION_WINDOW 2
+
+/* Late-move reductions: past the first LMR_FULL_MOVES children of a node
+ * with at least LMR_MIN_DEPTH plies left, a child is searched LMR_REDUCTION
+ * plies shallower first and again at full depth only if it beats alpha */
+#define LMR_FULL_MOVES 3
+#define LMR_MIN_DEPTH 4
+#define LMR_REDUCTION 2
+
+/* Forced-move extensions: a node the threat analysis leaves one move has
+ * that move searched at its own depth rather than a ply less, at most
+ * FORCED_EXTENSIONS times along any line; the tree is generated to match */
+#define FORCED_EXTENSIONS 2
+
+/* Frames on a search task's stack; deeper than any search it runs */
+#define TASK_STACK 64
+/* Nodes a timed decision searches between looks at the clock */
+#define DECIDE_SLICE 4096
+
+/* Search task states */
+#define TASK_START 0
+#define TASK_NEXT 1       /* between iterations */
+#define TASK_ITERATION 2  /* searching the root */
+#define TASK_DONE 3
+#define TASK_CANCELLED 4
+#define TASK_SUSPENDED 5  /* returned by run_task() only */
+
+/* Frame stages */
+#define STAGE_ENTER 0     /* node not yet examined */
+#define STAGE_FULL 1      /* child searched with the full window */
+#define STAGE_SCOUT 2     /* child searched with a null window */
+#define STAGE_REDUCED 3   /* child searched with a null window, shallower */
+
 typedef struct tree {
 	struct list_node* root;
-	struct list* search_order;
 } tree;
 
+/* One node being searched */
+typedef struct search_frame {
+	struct list_node* node;
+	int depth;
+	int alpha;
+	int beta;
+	int window_alpha;       /* window the node was entered with */
+	int window_beta;
+	int best;
+	int move;               /* column of the best child so far */
+	int index;              /* child being searched */
+	unsigned int columns;   /* bit per column worth searching */
+	unsigned char stage;
+	unsigned char maximizing;
+	unsigned char root;
+	unsigned char batched;  /* children scored together as one batch */
+	unsigned char extend;   /* 1 when the one move left is extended */
+	unsigned char extensions; /* moves extended on the way to the node */
+} search_frame;
+
+/* A root move with its score and principal variation */
+typedef struct search_line {
+	int move;
+	int score;
+	int exact;              /* 0 when score is only a bound */
+	int length;
+	signed char pv[TASK_STACK];
+} search_line;
+
+/*
+ * A search whose recursion lives on an explicit stack, so it can be
+ * suspended after any number of nodes and resumed later.
+ */
+typedef struct search_task {
+	struct list_node* root;
+	int maximizing;
+	int state;
+	int cancel;
+	long nodes;
+	/* Iterative deepening */
+	int depth;
+	int alpha;
+	int beta;
+	int score;
+	unsigned int columns;
+	/* Result of the last completed iteration */
+	int best_move;
+	int best_score;
+	int reached;            /* depth of the last completed iteration */
+	uint64_t trace_start;   /* start of the current iteration's span */
+	/* Probes made in the current iteration, traced with it */
+	long cache_probes;
+	long cache_hits;
+	long tablebase_probes;
+	long tablebase_hits;
+	/* Multi-PV: the k best root moves get exact scores */
+	int multipv;
+	int num_lines;
+	search_line* lines;
+	int top;
+	search_frame stack[TASK_STACK];
+	/* Principal variation of each frame, built as the frames finish */
+	signed char pv[TASK_STACK][TASK_STACK];
+	int pv_length[TASK_STACK];
+} search_task;
+
 /* Initialize functions */
 tree* create_tree();
 void delete_tree(tree* tree);
@@ -25,16 +133,46 @@ void set_root(tree* tree, struct board* board);
 /* Game tree functions */
 void generate_permutations(struct list_node** node, board* original, int nth_perm, int player);
 void delete_permutations(struct tree** game_tree, board** b);
+void set_transpositions(int enabled);
 
 /* Minimax functions */
-void max_value(struct list_node** parent, int* alpha, int* beta);
+void max_value(struct list_node** parent, int depth, int alpha, int beta);
 void max_decision(struct list_node** parent);
 void max(int* best, struct list_node** action, struct list_node** parent);
 
-void min_value(struct list_node** parent, int* alpha, int* beta);
+void min_value(struct list_node** parent, int depth, int alpha, int beta);
 void min_decision(struct list_node** parent);
 void min(int* best, struct list_node** action, struct list_node** parent);
 
+int multipv_decision(struct list_node** parent, int maximizing, int k, search_line* lines);
+
+/* Resumable search functions */
+search_task* create_task(struct list_node* root, int maximizing);
+void delete_task(search_task* t);
+int run_task(search_task* t, long max_nodes);
+void run_tasks(search_task** tasks, int num_tasks, long slice);
+void cancel_task(search_task* t);
+void set_multipv(search_task* t, int k);
+
+/* Search settings */
+void set_tablebase(tablebase* tb);
+void set_cache(ttable* tt);
+void set_evaluator(int kind, int num_rows, int num_cols, int r);
+void set_network(nn_network* net);
+void set_reductions(int enabled);
+void set_extensions(int enabled);
+void set_search_depth(int depth);
+void set_search_time(long ms);
+void get_search_limits(int* depth, long* ms);
+unsigned long get_search_epoch();
+uint64_t get_search_settings();
+
+/* Search statistics */
+long get_search_nodes();
+void reset_search_nodes();
+int get_search_depth();
+int get_search_pv(signed char* pv);
+
 /* Minimax utility functions */
 void best_horizontal_max(struct list_node** parent);
 void best_vertical_max(struct list_node** parent);
@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "board.h"
+#include "bitboard.h"
+#include "linked_list.h"
+#include "threat.h"
+#include "treedump.h"
+
+/* Nodes converted and written per fwrite() */
+#define TD_BATCH 4096
+
+/* A shared block of children and the index it was written at */
+typedef struct td_block {
+	struct list* children;
+	uint32_t first;
+} td_block;
+
+/**
+ * Finds the slot for a shared block: the one holding it, or the empty slot
+ * where it belongs.
+ */
+static td_block* find_block(td_block* blocks, long size, struct list* children)
+{
+	long i = (((uintptr_t) children >> 4) * 0x9e3779b97f4a7c15ULL) & (size - 1);
+	while (blocks[i].children != NULL && blocks[i].children != children)
+		i = (i + 1) & (size - 1);
+	return &blocks[i];
+}
+
+/**
+ * Writes the tree below a node breadth first. Blocks of children referenced
+ * by several parents are written once; the others need no lookup at all.
+ * On boards that fit a bitboard, a child's key and whether its move won
+ * follow from its parent's key, so no board is scanned.
+ * @param path: the file to write
+ * @param root: the root of the tree, already searched
+ * @param player: the player to move at the root
+ * @return 0 on success, 1 on failure
+ */
+int td_write(const char* path, struct list_node* root, int player)
+{
+	FILE* out = fopen(path, "wb");
+	if (out == NULL)
+		return 1;
+
+	// Breadth-first order: every node's children are appended in one run
+	long count = 1, capacity = 1024, i;
+	struct list_node** order = malloc(sizeof(struct list_node*) * capacity);
+	unsigned char* plies = malloc(capacity);
+	uint32_t* first = malloc(sizeof(uint32_t) * capacity);
+	unsigned char* flags = malloc(capacity);
+	uint64_t* keys = malloc(sizeof(uint64_t) * capacity);
+	int fits = bitboard_fits(root->value.row_len, root->value.column_len);
+	long blocks_size = 0, blocks_count = 0;
+	td_block* blocks = NULL;
+	int max_ply = 0;
+
+	order[0] = root;
+	plies[0] = 0;
+	flags[0] = 0;
+	keys[0] = board_key(&root->value);
+	for (i = 0; i < count; i++) {
+		struct list* children = order[i]->children;
+		first[i] = 0;
+		if (children == NULL || children->size == 0)
+			continue;
+
+		td_block* block = NULL;
+		if (children->refs > 1) {
+			if (2 * (blocks_count + 1) > blocks_size) {
+				td_block* old = blocks;
+				long old_size = blocks_size, j;
+				blocks_size = (old_size == 0) ? 1024 : old_size * 2;
+				blocks = calloc(blocks_size, sizeof(td_block));
+				for (j = 0; j < old_size; j++) {
+					if (old[j].children != NULL)
+						*find_block(blocks, blocks_size, old[j].children) = old[j];
+				}
+				free(old);
+			}
+			block = find_block(blocks, blocks_size, children);
+			if (block->children != NULL) {
+				first[i] = block->first;
+				flags[i] |= TD_SHARED;
+				continue;
+			}
+			block->children = children;
+			block->first = count;
+			blocks_count++;
+		}
+
+		if (count + children->size > capacity) {
+			while (count + children->size > capacity)
+				capacity *= 2;
+			order = realloc(order, sizeof(struct list_node*) * capacity);
+			plies = realloc(plies, capacity);
+			first = realloc(first, sizeof(uint32_t) * capacity);
+			flags = realloc(flags, capacity);
+			keys = realloc(keys, sizeof(uint64_t) * capacity);
+		}
+
+		// The player moving into the children, and the cells that win for them
+		int mover = (plies[i] % 2 == 0) ? player : 3 - player;
+		bitboard bb;
+		uint64_t playable = 0, wins = 0;
+		if (fits) {
+			bitboard_from_key(keys[i], root->value.row_len, root->value.column_len, root->value.r, &bb);
+			playable = playable_cells(bb.mask, bb.row_len, bb.column_len);
+			wins = winning_cells((mover == 1) ? bb.p1 : bb.p1 ^ bb.mask, bb.mask,
+					bb.row_len, bb.column_len, bb.r);
+		}
+
+		first[i] = count;
+		int j;
+		for (j = 0; j < children->size; j++) {
+			struct list_node* child = &children->head[j];
+			order[count] = child;
+			plies[count] = plies[i] + 1;
+			if (fits) {
+				// The key gains the cell once for the mask and again for p1
+				uint64_t cell = playable & column_mask(bb.row_len, child->value.move);
+				keys[count] = keys[i] + cell * ((mover == 1) ? 2 : 1);
+				flags[count] = (cell & wins) ? TD_TERMINAL : 0;
+			} else {
+				keys[count] = board_key(&child->value);
+				flags[count] = (terminal_test(&child->value) > 0) ? TD_TERMINAL : 0;
+			}
+			count++;
+		}
+		if (plies[i] + 1 > max_ply)
+			max_ply = plies[i] + 1;
+	}
+
+	td_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TD_MAGIC, 4);
+	header.version = TD_VERSION;
+	header.row_len = root->value.row_len;
+	header.column_len = root->value.column_len;
+	header.r = root->value.r;
+	header.player = player;
+	header.cell_bytes = board_bytes(&root->value);
+	header.max_ply = max_ply;
+	header.num_nodes = count;
+	header.nodes = (sizeof(header) + header.cell_bytes + 7) & ~7UL;
+
+	unsigned char padding[8] = { 0 };
+	fwrite(&header, sizeof(header), 1, out);
+	fwrite(root->value.cells, 1, header.cell_bytes, out);
+	fwrite(padding, 1, header.nodes - sizeof(header) - header.cell_bytes, out);
+
+	td_node batch[TD_BATCH];
+	long n = 0;
+	for (i = 0; i < count; i++) {
+		struct list_node* node = order[i];
+		td_node* out_node = &batch[n++];
+		memset(out_node, 0, sizeof(td_node));
+		out_node->key = keys[i];
+		out_node->first_child = first[i];
+		out_node->num_children = (node->children != NULL) ? node->children->size : 0;
+		out_node->score = node->value.best_score;
+		out_node->move = node->value.move;
+		out_node->ply = plies[i];
+		out_node->flags = flags[i];
+		if (n == TD_BATCH) {
+			fwrite(batch, sizeof(td_node), n, out);
+			n = 0;
+		}
+	}
+	fwrite(batch, sizeof(td_node), n, out);
+
+	free(order);
+	free(plies);
+	free(first);
+	free(flags);
+	free(keys);
+	free(blocks);
+	int failed = ferror(out);
+	return (fclose(out) == 0 && !failed) ? 0 : 1;
+}
+
+/**
+ * Checks that the root cells and node array fit the file, and that every
+ * node's ply, move and child range are ones the readers can index with:
+ * children lie inside the array and after their parent, so walks down the
+ * tree end.
+ */
+static int dump_fits(const unsigned char* data, size_t length)
+{
+	const td_header* header = (const td_header*) data;
+	if (header->row_len * header->column_len > BOARD_MAX_CELLS ||
+			header->cell_bytes != (header->row_len * header->column_len + 3) / 4 ||
+			header->nodes < sizeof(td_header) + header->cell_bytes || header->nodes % 8 != 0 ||
+			header->nodes > length || header->num_nodes == 0 ||
+			header->num_nodes > (length - header->nodes) / sizeof(td_node))
+		return 0;
+
+	const td_node* nodes = (const td_node*) (data + header->nodes);
+	uint64_t i;
+	for (i = 0; i < header->num_nodes; i++) {
+		if (nodes[i].ply > header->max_ply)
+			return 0;
+		if (i > 0 && (nodes[i].move < 0 || nodes[i].move >= header->column_len))
+			return 0;
+		if (nodes[i].num_children > 0 && (nodes[i].first_child <= i ||
+				nodes[i].first_child + (uint64_t) nodes[i].num_children > header->num_nodes))
+			return 0;
+	}
+	return 1;
+}
+
+/**
+ * Memory-maps a tree dump read-only.
+ * @param path: the file to open
+ * @return the dump, or NULL if it could not be opened, is not one, or is
+ * malformed
+ */
+treedump* td_open(const char* path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(td_header)) {
+		close(fd);
+		return NULL;
+	}
+
+	void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return NULL;
+
+	const td_header* header = (const td_header*) data;
+	if (memcmp(header->magic, TD_MAGIC, 4) != 0 || header->version != TD_VERSION ||
+			!dump_fits(data, st.st_size)) {
+		munmap(data, st.st_size);
+		return NULL;
+	}
+
+	treedump* td = malloc(sizeof(treedump));
+	td->data = data;
+	td->length = st.st_size;
+	td->header = header;
+	td->cells = td->data + sizeof(td_header);
+	td->nodes = (const td_node*) (td->data + header->nodes);
+	return td;
+}
+
+/**
+ * Unmaps and deallocates a tree dump.
+ * @param td: the dump to close
+ */
+void td_close(treedump* td)
+{
+	if (td == NULL)
+		return;
+	munmap((void*) td->data, td->length);
+	free(td);
+}
+
+/**
+ * Returns the index of the child reached by playing a column.
+ * @param td: the dump
+ * @param index: the parent node
+ * @param column: the column played
+ * @return the child's index, or -1 when the node has no such child
+ */
+long td_child(treedump* td, long index, int column)
+{
+	const td_node* node = &td->nodes[index];
+	long i;
+	for (i = node->first_child; i < node->first_child + node->num_children; i++) {
+		if (td->nodes[i].move == column)
+			return i;
+	}
+	return -1;
+}
+
+/**
+ * Returns the player to move at a node.
+ * @param td: the dump
+ * @param index: the node
+ */
+int td_player(treedump* td, long index)
+{
+	int player = td->header->player;
+	return (td->nodes[index].ply % 2 == 0) ? player : 3 - player;
+}
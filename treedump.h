@@ -0,0 +1,74 @@
+/*
+ * treedump.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+#ifndef TREEDUMP_H_
+#define TREEDUMP_H_
+#include <stdint.h>
+#include <stddef.h>
+#include "linked_list.h"
+
+#define TD_MAGIC "C4TD"
+#define TD_VERSION 1
+
+/* Node flags */
+#define TD_TERMINAL 1     /* someone has won, the node is not expanded */
+#define TD_SHARED 2       /* children belong to an earlier node too (--dag) */
+
+/*
+ * File layout: header, the root board's packed cells padded to 8 bytes,
+ * then num_nodes td_nodes in breadth-first order. The root is node 0 and
+ * every node's children are contiguous, so a subtree is reached by index
+ * arithmetic on the mapped file alone. Shared children are written once
+ * and referenced by every parent holding them.
+ */
+typedef struct td_header {
+	char magic[4];
+	uint32_t version;
+	uint8_t row_len;
+	uint8_t column_len;
+	uint8_t r;
+	uint8_t player;       /* player to move at the root */
+	uint16_t cell_bytes;  /* bytes of packed root cells */
+	uint16_t max_ply;
+	uint64_t num_nodes;
+	uint64_t nodes;       /* offset of the node array */
+} td_header;
+
+typedef struct td_node {
+	uint64_t key;         /* board_key() of the position */
+	uint32_t first_child; /* index of the first child */
+	uint16_t num_children;
+	int16_t score;
+	int8_t move;          /* column played into the node; the root's best */
+	uint8_t ply;
+	uint8_t flags;
+	uint8_t reserved[5];
+} td_node;
+
+typedef struct treedump {
+	const unsigned char* data;
+	size_t length;
+	const td_header* header;
+	const unsigned char* cells;
+	const td_node* nodes;
+} treedump;
+
+/*
+ * Writer functions
+ */
+/* Write the tree below root, whose player to move is given */
+int td_write(const char* path, struct list_node* root, int player);
+
+/*
+ * Reader functions
+ */
+treedump* td_open(const char* path);
+void td_close(treedump* td);
+/* Index of the child reached by playing column, or -1 */
+long td_child(treedump* td, long index, int column);
+/* Player to move at a node */
+int td_player(treedump* td, long index);
+
+#endif /* TREEDUMP_H_ */
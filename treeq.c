@@ -0,0 +1,194 @@
+/*
+ * treeq.c
+ *
+ * Queries a game tree written with --dump-tree without loading it: the
+ * file is mapped and walked in place. Commands:
+ *   info                  header and node counts
+ *   top [k]               the k best root moves with their principal lines
+ *   subtree [column ...]  the node reached by a move sequence and its children
+ *   histogram [ply]       scores of every node, or of the nodes at one ply
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "board.h"
+#include "treedump.h"
+
+#define TREEQ_USAGE "usage -- ./treeq file info|top [k]|subtree [column ...]|histogram [ply]"
+
+void error(char* msg);
+
+/**
+ * Returns non-zero when score a is better than b for the player to move.
+ */
+static int better(int a, int b, int player)
+{
+	return (player == 1) ? a > b : a < b;
+}
+
+/**
+ * Returns the index of the best child of a node for its player to move,
+ * or -1 for a leaf.
+ */
+static long best_child(treedump* td, long index)
+{
+	const td_node* node = &td->nodes[index];
+	int player = td_player(td, index);
+	long best = -1, i;
+	for (i = node->first_child; i < node->first_child + node->num_children; i++) {
+		if (best < 0 || better(td->nodes[i].score, td->nodes[best].score, player))
+			best = i;
+	}
+	return best;
+}
+
+/**
+ * Prints the header and the number of nodes at every ply.
+ */
+static void info(treedump* td)
+{
+	const td_header* h = td->header;
+	long* per_ply = calloc(h->max_ply + 1, sizeof(long));
+	long terminal = 0, shared = 0;
+	uint64_t i;
+	for (i = 0; i < h->num_nodes; i++) {
+		per_ply[td->nodes[i].ply]++;
+		terminal += (td->nodes[i].flags & TD_TERMINAL) != 0;
+		shared += (td->nodes[i].flags & TD_SHARED) != 0;
+	}
+
+	printf("%dx%d r=%d, player %d to move, best column %d score %d\n", h->row_len, h->column_len,
+			h->r, h->player, td->nodes[0].move, td->nodes[0].score);
+	printf("%llu nodes, %ld terminal, %ld sharing their children\n",
+			(unsigned long long) h->num_nodes, terminal, shared);
+	int ply;
+	for (ply = 0; ply <= h->max_ply; ply++) {
+		printf("  ply %2d: %ld nodes\n", ply, per_ply[ply]);
+	}
+	free(per_ply);
+}
+
+static treedump* sort_dump;
+
+static int compare_children(const void* a, const void* b)
+{
+	int x = sort_dump->nodes[*(const long*) a].score, y = sort_dump->nodes[*(const long*) b].score;
+	return (sort_dump->header->player == 1) ? (y > x) - (y < x) : (x > y) - (x < y);
+}
+
+/**
+ * Prints the k best root moves, each followed by the line of best replies
+ * through the tree.
+ */
+static void top(treedump* td, int k)
+{
+	const td_node* root = &td->nodes[0];
+	long* moves = malloc(sizeof(long) * (root->num_children + 1));
+	int i;
+	for (i = 0; i < root->num_children; i++) {
+		moves[i] = root->first_child + i;
+	}
+	sort_dump = td;
+	qsort(moves, root->num_children, sizeof(long), compare_children);
+
+	for (i = 0; i < root->num_children && i < k; i++) {
+		long index = moves[i];
+		printf("column %d score %d pv", td->nodes[index].move, td->nodes[index].score);
+		while (index >= 0) {
+			printf(" %d", td->nodes[index].move);
+			index = best_child(td, index);
+		}
+		printf("\n");
+	}
+	free(moves);
+}
+
+/**
+ * Prints the position reached by a sequence of columns from the root, and
+ * every child of its node.
+ */
+static void subtree(treedump* td, char** columns, int num_columns)
+{
+	const td_header* h = td->header;
+	board b;
+	memset(&b, 0, sizeof(b));
+	b.row_len = h->row_len;
+	b.column_len = h->column_len;
+	b.r = h->r;
+	b.size = h->row_len * h->column_len;
+	b.move = -1;
+	memcpy(b.cells, td->cells, h->cell_bytes);
+
+	long index = 0;
+	int i;
+	for (i = 0; i < num_columns; i++) {
+		int column = strtol(columns[i], NULL, 10);
+		long child = td_child(td, index, column);
+		if (child < 0) {
+			printf("column %d is not in the tree after %d moves\n", column, i);
+			exit(1);
+		}
+		add_checker(&b, column, td_player(td, index));
+		index = child;
+	}
+
+	const td_node* node = &td->nodes[index];
+	print_board(&b);
+	printf("node %ld ply %d player %d to move score %d%s%s\n", index, node->ply, td_player(td, index),
+			node->score, (node->flags & TD_TERMINAL) ? " terminal" : "",
+			(node->flags & TD_SHARED) ? " shared" : "");
+	long best = best_child(td, index);
+	for (i = 0; i < node->num_children; i++) {
+		const td_node* child = &td->nodes[node->first_child + i];
+		printf("  column %d score %d children %d%s\n", child->move, child->score, child->num_children,
+				(node->first_child + i == best) ? " best" : "");
+	}
+}
+
+/**
+ * Prints how many nodes hold each score, over the whole tree or one ply.
+ */
+static void histogram(treedump* td, int ply)
+{
+	long* counts = calloc(65536, sizeof(long));
+	uint64_t i;
+	for (i = 0; i < td->header->num_nodes; i++) {
+		if (ply < 0 || td->nodes[i].ply == ply)
+			counts[td->nodes[i].score + 32768]++;
+	}
+	int score;
+	for (score = 0; score < 65536; score++) {
+		if (counts[score] > 0)
+			printf("%6d %ld\n", score - 32768, counts[score]);
+	}
+	free(counts);
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3) { error(TREEQ_USAGE); }
+
+	treedump* td = td_open(argv[1]);
+	if (td == NULL) { error("Could not open tree dump"); }
+
+	if (strcmp(argv[2], "info") == 0) {
+		info(td);
+	} else if (strcmp(argv[2], "top") == 0) {
+		top(td, (argc > 3) ? strtol(argv[3], NULL, 10) : td->header->column_len);
+	} else if (strcmp(argv[2], "subtree") == 0) {
+		subtree(td, argv + 3, argc - 3);
+	} else if (strcmp(argv[2], "histogram") == 0) {
+		histogram(td, (argc > 3) ? strtol(argv[3], NULL, 10) : -1);
+	} else {
+		error(TREEQ_USAGE);
+	}
+
+	td_close(td);
+	return 0;
+}
+
+void error(char* msg)
+{
+	printf("%s\n", msg);
+	exit(1);
+}
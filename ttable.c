@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ttable.h"
+
+/*
+ * Data word: score (16 bits, offset by 32768), depth (8), bound (2),
+ * side to move (1), then move + 1 (8, 0 when there is none).
+ */
+#define TT_SCORE(d) ((int) ((d) & 0xffff) - 32768)
+#define TT_DEPTH(d) ((int) (((d) >> 16) & 0xff))
+#define TT_BOUND(d) ((int) (((d) >> 24) & 3))
+#define TT_SIDE(d) ((int) (((d) >> 26) & 1))
+#define TT_MOVE(d) ((int) (((d) >> 27) & 0xff) - 1)
+
+/**
+ * Opens a cache file, creating and sizing it if it is empty. The file is
+ * locked while its header is checked or written, so processes starting at
+ * the same time agree on its contents.
+ * @param path: the cache file
+ * @param num_rows: number of rows on the board
+ * @param num_cols: number of columns on the board
+ * @param r: number of checkers in a row needed to win
+ * @param settings: fingerprint of the search settings, see
+ * get_search_settings(); scores stored under other settings are not valid
+ * for these, so such a file is refused
+ * @param bucket_bits: log2 of the number of buckets for a new file
+ * @return the cache, or NULL if the file could not be opened, is malformed,
+ * or belongs to a different board or different settings
+ */
+ttable* tt_open(const char* path, int num_rows, int num_cols, int r, uint64_t settings, int bucket_bits)
+{
+	int fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0)
+		return NULL;
+	tt_header header;
+	struct stat st;
+	if (flock(fd, LOCK_EX) != 0 || fstat(fd, &st) != 0) {
+		close(fd);
+		return NULL;
+	}
+	if (st.st_size == 0) {
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, TT_MAGIC, 4);
+		header.version = TT_VERSION;
+		header.row_len = num_rows;
+		header.column_len = num_cols;
+		header.r = r;
+		header.bucket_bits = bucket_bits;
+		header.settings = settings;
+		size_t length = sizeof(tt_header) + sizeof(tt_bucket) * ((size_t) 1 << bucket_bits);
+		if (ftruncate(fd, length) != 0 || pwrite(fd, &header, sizeof(header), 0) != sizeof(header)) {
+			close(fd);
+			return NULL;
+		}
+		st.st_size = length;
+	} else if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+			memcmp(header.magic, TT_MAGIC, 4) != 0 || header.version != TT_VERSION ||
+			header.row_len != num_rows || header.column_len != num_cols || header.r != r ||
+			header.settings != settings ||
+			header.bucket_bits < 1 || header.bucket_bits > TT_MAX_BITS ||
+			(size_t) st.st_size != sizeof(tt_header) + sizeof(tt_bucket) * ((size_t) 1 << header.bucket_bits)) {
+		close(fd);
+		return NULL;
+	}
+	flock(fd, LOCK_UN);
+
+	void* data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return NULL;
+
+	ttable* tt = malloc(sizeof(ttable));
+	tt->data = data;
+	tt->length = st.st_size;
+	tt->buckets = (tt_bucket*) (tt->data + sizeof(tt_header));
+	tt->bucket_bits = header.bucket_bits;
+	return tt;
+}
+
+/**
+ * Unmaps and deallocates a cache. The entries stay in the file.
+ * @param tt: the cache to close
+ */
+void tt_close(ttable* tt)
+{
+	if (tt == NULL)
+		return;
+	munmap(tt->data, tt->length);
+	free(tt);
+}
+
+/**
+ * Returns the bucket for a key. Position keys are far from uniform, so
+ * they are mixed before the top bits are taken.
+ */
+static tt_bucket* find_bucket(ttable* tt, uint64_t key)
+{
+	return &tt->buckets[(key * 0x9e3779b97f4a7c15ULL) >> (64 - tt->bucket_bits)];
+}
+
+/**
+ * Reads an entry's words. The data word is returned only when it matches
+ * the key, otherwise 0.
+ */
+static uint64_t read_entry(tt_entry* e, uint64_t key)
+{
+	uint64_t check = __atomic_load_n(&e->check, __ATOMIC_RELAXED);
+	uint64_t data = __atomic_load_n(&e->data, __ATOMIC_RELAXED);
+	return ((check ^ data) == key) ? data : 0;
+}
+
+/**
+ * Looks a position up.
+ * @param tt: the cache
+ * @param key: the position's canonical key
+ * @param maximizing: 1 when the player to move is maximizing
+ * @param result: filled in when the position is found
+ * @return 1 when the position was found
+ */
+int tt_probe(ttable* tt, uint64_t key, int maximizing, tt_result* result)
+{
+	tt_bucket* bucket = find_bucket(tt, key);
+	int i;
+	for (i = 0; i < TT_WAYS; i++) {
+		uint64_t data = read_entry(&bucket->entries[i], key);
+		if (data == 0 || TT_SIDE(data) != maximizing)
+			continue;
+		result->score = TT_SCORE(data);
+		result->depth = TT_DEPTH(data);
+		result->bound = TT_BOUND(data);
+		result->move = TT_MOVE(data);
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Stores a search result. An entry for the same position is only replaced
+ * by a search at least as deep; otherwise the shallowest entry in the
+ * bucket makes way.
+ * @param tt: the cache
+ * @param key: the position's canonical key
+ * @param maximizing: 1 when the player to move is maximizing
+ * @param depth: the depth searched
+ * @param bound: TT_EXACT, TT_LOWER or TT_UPPER
+ * @param score: the score found
+ * @param move: the best column, or -1
+ */
+void tt_store(ttable* tt, uint64_t key, int maximizing, int depth, int bound, int score, int move)
+{
+	tt_bucket* bucket = find_bucket(tt, key);
+	tt_entry* victim = NULL;
+	int shallowest = 256;
+	int i;
+
+	for (i = 0; i < TT_WAYS; i++) {
+		tt_entry* e = &bucket->entries[i];
+		uint64_t data = read_entry(e, key);
+		if (data != 0 && TT_SIDE(data) == maximizing) {
+			if (TT_DEPTH(data) > depth)
+				return;
+			victim = e;
+			break;
+		}
+		// Empty slots count as shallower than any entry
+		uint64_t other = __atomic_load_n(&e->data, __ATOMIC_RELAXED);
+		int other_depth = (other == 0) ? -1 : TT_DEPTH(other);
+		if (other_depth < shallowest) {
+			shallowest = other_depth;
+			victim = e;
+		}
+	}
+
+	uint64_t data = (uint64_t) (score + 32768) | (uint64_t) depth << 16 | (uint64_t) bound << 24 |
+			(uint64_t) (maximizing != 0) << 26 | (uint64_t) (move + 1) << 27;
+	__atomic_store_n(&victim->check, key ^ data, __ATOMIC_RELAXED);
+	__atomic_store_n(&victim->data, data, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,76 @@
+/*
+ * ttable.h
+ *
+ *  Created on: Oct 19, 2026
+ */
+#ifndef TTABLE_H_
+#define TTABLE_H_
+#include <stdint.h>
+#include <stddef.h>
+
+#define TT_MAGIC "C4TT"
+#define TT_VERSION 2
+/* Entries per bucket; a bucket fills one 64-byte cache line */
+#define TT_WAYS 4
+/* log2 of the number of buckets in a new cache file (4 MB) */
+#define TT_DEFAULT_BITS 16
+/* Largest bucket_bits a file may have (64 GB of buckets) */
+#define TT_MAX_BITS 30
+
+/* Bounds */
+#define TT_NONE 0
+#define TT_EXACT 1
+#define TT_LOWER 2   /* failed high, the value is at least score */
+#define TT_UPPER 3   /* failed low, the value is at most score */
+
+/*
+ * File layout: a tt_header padded to 64 bytes, then 2^bucket_bits buckets.
+ * The file is mapped shared, so every process using it sees the others'
+ * entries. Entries are written without locks: each stores its key XORed
+ * with its data, and a reader only accepts an entry whose two words agree,
+ * so an entry torn by a concurrent writer reads as a miss.
+ */
+typedef struct tt_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t row_len;
+	uint32_t column_len;
+	uint32_t r;
+	uint32_t bucket_bits;
+	uint64_t settings;      /* get_search_settings() of the runs that fill it */
+	unsigned char reserved[32];
+} tt_header;
+
+typedef struct tt_entry {
+	uint64_t check;   /* key ^ data */
+	uint64_t data;
+} tt_entry;
+
+typedef struct tt_bucket {
+	tt_entry entries[TT_WAYS];
+} tt_bucket;
+
+/* An unpacked entry */
+typedef struct tt_result {
+	int score;
+	int depth;
+	int bound;
+	int move;         /* best column, -1 if none */
+} tt_result;
+
+typedef struct ttable {
+	unsigned char* data;
+	size_t length;
+	tt_bucket* buckets;
+	int bucket_bits;
+} ttable;
+
+/* Open or create a cache file for an n x m connect-r board, searched with
+ * the given settings fingerprint */
+ttable* tt_open(const char* path, int num_rows, int num_cols, int r, uint64_t settings, int bucket_bits);
+void tt_close(ttable* tt);
+/* 1 when an entry for the key and side to move was found */
+int tt_probe(ttable* tt, uint64_t key, int maximizing, tt_result* result);
+void tt_store(ttable* tt, uint64_t key, int maximizing, int depth, int bound, int score, int move);
+
+#endif /* TTABLE_H_ */